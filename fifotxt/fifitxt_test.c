@@ -28,6 +28,12 @@ static void assert(bool value, const char *error) {
 #define PRINT_TEST_NAME(s)        v_printf(#s, 1)
 
 
+static uint8_t last_match_id;
+static uint16_t match_cnt;
+static bool match_msg_ok;
+static uint32_t test_ticks;
+
+
 
 static void fifotxt_push_byte_test(__fifotxt_handle *handle);
 static void fifotxt_push_msg_test(__fifotxt_handle *handle);
@@ -36,6 +42,17 @@ static void fifotxt_cmp_last_test(__fifotxt_handle *handle);
 static void fifotxt_cmp_first_test(__fifotxt_handle *handle);
 static void fifotxt_pop_msg_test(__fifotxt_handle *handle);
 static void fifotxt_discard_msg_test(__fifotxt_handle *handle);
+static void fifotxt_push_bytes_test(__fifotxt_handle *handle);
+static void fifotxt_peek_msg_test(__fifotxt_handle *handle);
+static void peek_msgs(__fifotxt_handle *handle);
+static void fifotxt_packed_test(void);
+static void fifotxt_matcher_test(void);
+static void fifotxt_binary_seq_test(void);
+static void fifotxt_overflow_test(void);
+static void fifotxt_idle_test(void);
+static uint32_t test_timestamp(void);
+static void on_match_test(__fifotxt_handle * const fh, const uint8_t id, const uint8_t * const msg, const uint16_t len);
+static void push_str(__fifotxt_handle *handle, const char *str);
 
 
 /**
@@ -92,6 +109,29 @@ void fifotxt_run_tests(void)
     fifotxt_discard_msg_test(&test_fifotxt);
     FIFOTXT_FLUSH_FIFO(&test_fifotxt);
 
+    /*******/
+    fifotxt_push_bytes_test(&test_fifotxt);
+    FIFOTXT_FLUSH_FIFO(&test_fifotxt);
+
+    /*******/
+    fifotxt_peek_msg_test(&test_fifotxt);
+    FIFOTXT_FLUSH_FIFO(&test_fifotxt);
+
+    /*******/
+    fifotxt_packed_test();
+
+    /*******/
+    fifotxt_matcher_test();
+
+    /*******/
+    fifotxt_binary_seq_test();
+
+    /*******/
+    fifotxt_overflow_test();
+
+    /*******/
+    fifotxt_idle_test();
+
     v_printf("Fifotxt tests have finished successfully\r\n", 1);
 }
 
@@ -302,5 +342,525 @@ static void fifotxt_discard_msg_test(__fifotxt_handle *handle)
 }
 
 
+/**
+ *
+ */
+static void fifotxt_push_bytes_test(__fifotxt_handle *handle)
+{
+    static const uint8_t chunk[] = "\n\r\nAT1\r\nAT3\r\n\0\nAT5\r\n\n\n\r\r\nA";
+    uint8_t buf[FIFOTXT_TEST_MSG_SIZE];
+    uint16_t msgs;
+    uint16_t i;
+
+    PRINT_TEST_NAME(fifotxt_push_bytes_test\r\n);
+
+    assert(!FIFOTXT_IS_FIFO_NOT_EMPTY(handle), "Fifo should be empty");
+
+    /* all alignments of the chunk */
+    for (i = 0; i < 4; i++) {
+        msgs = FIFOTXT_PUSH_BYTES(handle, chunk + i, sizeof(chunk) - 1 - i);
+        assert(msgs == 3, "Push bytes should complete 3 messages");
+
+        FIFOTXT_PUSH_BYTE(handle, 'T');
+        FIFOTXT_PUSH_BYTE(handle, FIFOTXT_TERMINATOR);
+
+        FIFOTXT_POP_MSG(handle, buf);
+        assert(str_cmp((const char *)buf, "AT1"), "Push bytes AT1");
+        FIFOTXT_POP_MSG(handle, buf);
+        assert(str_cmp((const char *)buf, "AT3"), "Push bytes AT3");
+        FIFOTXT_POP_MSG(handle, buf);
+        assert(str_cmp((const char *)buf, "AT5"), "Push bytes AT5");
+        FIFOTXT_POP_MSG(handle, buf);
+        assert(str_cmp((const char *)buf, "AT"), "Push bytes AT");
+
+        assert(!FIFOTXT_IS_FIFO_NOT_EMPTY(handle), "Fifo should be empty");
+    }
+}
+
+
+/**
+ *
+ */
+static void fifotxt_peek_msg_test(__fifotxt_handle *handle)
+{
+    uint8_t heap[FIFOTXT_TEST_MSG_SIZE * (FIFOTXT_TEST_QUEUE_SIZE + 1)];
+    uint16_t lens[FIFOTXT_TEST_QUEUE_SIZE];
+
+    __fifotxt_queue lens_fqueue = {
+        .queue = heap,
+        .size = FIFOTXT_TEST_QUEUE_SIZE,
+        .lens = lens
+    };
+
+    __fifotxt_buffer lens_fbuf = {
+        .buf = heap + (FIFOTXT_TEST_QUEUE_SIZE * FIFOTXT_TEST_MSG_SIZE),
+        .size = FIFOTXT_TEST_MSG_SIZE
+    };
+
+    __fifotxt_handle lens_fifotxt = {
+        .END_TOKEN = FIFOTXT_TERMINATOR,
+        .IGNORED_TOKEN = FIFOTXT_IGNORED,
+        .fqueue = &lens_fqueue,
+        .fbuf = &lens_fbuf
+    };
+
+    PRINT_TEST_NAME(fifotxt_peek_msg_test\r\n);
+
+    /* the length is counted on access */
+    peek_msgs(handle);
+
+    /* the length is stored */
+    create_fifotxt(&lens_fifotxt);
+    peek_msgs(&lens_fifotxt);
+
+    assert(lens[lens_fqueue.first] == 2, "Length should be stored");
+    assert(FIFOTXT_CMP_FIRST_MSG(&lens_fifotxt, "OK") && FIFOTXT_CMP_LAST_MSG(&lens_fifotxt, "E"), "Cmp by stored length");
+}
+
+
+/**
+ *
+ */
+static void peek_msgs(__fifotxt_handle *handle)
+{
+    const uint8_t *msg;
+    uint16_t len;
+    uint16_t i;
+
+    msg = FIFOTXT_PEEK_MSG(handle, 0, &len);
+    assert(msg == NULL && len == 0, "Peek from empty fifo");
+
+    /* the queue wraps */
+    for (i = 0; i < 3; i++) {
+        push_str(handle, "X\r");
+        FIFOTXT_DISCARD_MSG(handle);
+    }
+
+    push_str(handle, "AT1\r");
+    push_str(handle, "OK\r");
+    push_str(handle, "AT\r");
+    push_str(handle, "E\r");
+
+    msg = FIFOTXT_PEEK_MSG(handle, 0, &len);
+    assert(msg && len == 3 && mem_cmp(msg, "AT1", 3), "Peek the first msg");
+
+    msg = FIFOTXT_PEEK_MSG(handle, 2, &len);
+    assert(msg && len == 2 && mem_cmp(msg, "AT", 2), "Peek the third msg");
+
+    msg = FIFOTXT_PEEK_MSG(handle, 3, &len);
+    assert(msg && len == 1 && mem_cmp(msg, "E", 1), "Peek the last msg");
+
+    msg = FIFOTXT_PEEK_MSG(handle, 4, &len);
+    assert(msg == NULL && len == 0, "Peek over the last msg");
+
+    FIFOTXT_DISCARD_MSG(handle);
+
+    msg = FIFOTXT_PEEK_MSG(handle, 0, &len);
+    assert(msg && len == 2 && mem_cmp(msg, "OK", 2), "Peek after discard");
+}
+
+
+/**
+ *
+ */
+static void fifotxt_packed_test(void)
+{
+    uint8_t queue[16];
+    uint8_t fbuf[8];
+    uint8_t buf[8];
+    uint16_t len;
+
+    __fifotxt_queue test_fqueue = {
+        .queue = queue,
+        .size = sizeof(queue)
+    };
+
+    __fifotxt_buffer test_fbuf = {
+        .buf = fbuf,
+        .size = sizeof(fbuf)
+    };
+
+    __fifotxt_handle handle = {
+        .END_TOKEN = FIFOTXT_TERMINATOR,
+        .IGNORED_TOKEN = FIFOTXT_IGNORED,
+        .PACKED = true,
+        .fqueue = &test_fqueue,
+        .fbuf = &test_fbuf
+    };
+
+    PRINT_TEST_NAME(fifotxt_packed_test\r\n);
+
+    create_fifotxt(&handle);
+
+    /* 5 + 4 + 7 bytes fill the queue exactly */
+    push_str(&handle, "AT1\r\n");
+    push_str(&handle, "OK\r\n");
+    push_str(&handle, "ERROR\r\n");
+    push_str(&handle, "X\r\n");
+
+    assert(FIFOTXT_CMP_FIRST_MSG(&handle, "AT1"), "Packed first should be AT1");
+    assert(FIFOTXT_CMP_LAST_MSG(&handle, "ERROR"), "Packed last should be ERROR, X is dropped");
+
+    len = FIFOTXT_POP_MSG(&handle, buf);
+    assert(str_cmp((const char *)buf, "AT1") && len == 3, "Packed pop is worked wrong");
 
+    /* no space at the end, it goes to the start */
+    push_str(&handle, "X\r\n");
+    assert(FIFOTXT_CMP_LAST_MSG(&handle, "X"), "Packed last should be X");
+
+    assert(FIFOTXT_PEEK_MSG(&handle, 1, &len) && len == 5, "Packed peek ERROR");
+    assert(mem_cmp(FIFOTXT_PEEK_MSG(&handle, 2, &len), "X", 2) && len == 1, "Packed peek X after wrap");
+
+    len = FIFOTXT_POP_MSG(&handle, buf);
+    assert(str_cmp((const char *)buf, "OK") && len == 2, "Packed pop is worked wrong");
+
+    FIFOTXT_DISCARD_MSG(&handle);
+    assert(FIFOTXT_CMP_FIRST_MSG(&handle, "X"), "Packed first should be X after wrap");
+
+    len = FIFOTXT_POP_MSG(&handle, buf);
+    assert(str_cmp((const char *)buf, "X") && len == 1, "Packed pop is worked wrong");
+    assert(!FIFOTXT_IS_FIFO_NOT_EMPTY(&handle), "Packed fifo should be empty");
+
+    len = FIFOTXT_POP_MSG(&handle, buf);
+    assert(len == 0, "Packed pop from empty fifo");
+}
+
+
+/**
+ *
+ */
+static void fifotxt_matcher_test(void)
+{
+    static const char * const patterns[] = { "OK", "ERROR", "+CREG:", "+CR", "OK" };
+
+    __fifotxt_trie_node nodes[16];
+    uint8_t slots[4 * 16];
+    uint8_t packed[32];
+    uint8_t tags[4];
+    uint8_t fbuf[16];
+
+    __fifotxt_matcher matcher = {
+        .nodes = nodes,
+        .size = 16
+    };
+
+    __fifotxt_matcher small_matcher = {
+        .nodes = nodes,
+        .size = 4
+    };
+
+    __fifotxt_queue slot_fqueue = {
+        .queue = slots,
+        .size = 4,
+        .tags = tags
+    };
+
+    __fifotxt_queue packed_fqueue = {
+        .queue = packed,
+        .size = sizeof(packed)
+    };
+
+    __fifotxt_buffer test_fbuf = {
+        .buf = fbuf,
+        .size = sizeof(fbuf)
+    };
+
+    __fifotxt_handle slot_handle = {
+        .END_TOKEN = FIFOTXT_TERMINATOR,
+        .IGNORED_TOKEN = FIFOTXT_IGNORED,
+        .fqueue = &slot_fqueue,
+        .fbuf = &test_fbuf,
+        .matcher = &matcher,
+        .on_match = on_match_test
+    };
+
+    __fifotxt_handle packed_handle = {
+        .END_TOKEN = FIFOTXT_TERMINATOR,
+        .IGNORED_TOKEN = FIFOTXT_IGNORED,
+        .PACKED = true,
+        .fqueue = &packed_fqueue,
+        .fbuf = &test_fbuf,
+        .matcher = &matcher
+    };
+
+    PRINT_TEST_NAME(fifotxt_matcher_test\r\n);
+
+    assert(!fifotxt_matcher_compile(&small_matcher, patterns, 5), "Matcher should be too small");
+    assert(fifotxt_matcher_compile(&matcher, patterns, 5), "Matcher should be compiled");
+
+    assert(fifotxt_match(&matcher, (const uint8_t *)"OK", 2) == 1, "Match OK");
+    assert(fifotxt_match(&matcher, (const uint8_t *)"O", 1) == FIFOTXT_NO_MATCH, "Match O");
+    assert(fifotxt_match(&matcher, (const uint8_t *)"+CREG: 1,2", 10) == 3, "Match +CREG:");
+    assert(fifotxt_match(&matcher, (const uint8_t *)"+CRC", 4) == 4, "Match +CR");
+    assert(fifotxt_match(&matcher, (const uint8_t *)"RING", 4) == FIFOTXT_NO_MATCH, "Match RING");
+
+    create_fifotxt(&slot_handle);
+    match_cnt = 0;
+
+    push_str(&slot_handle, "+CREG: 1,2\r\n");
+    assert(match_cnt == 1 && last_match_id == 3, "Callback for +CREG:");
+    assert(match_msg_ok, "Callback gets the queued message");
+
+    push_str(&slot_handle, "RING\r\n");
+    push_str(&slot_handle, "ERROR\r\n");
+    assert(match_cnt == 2 && last_match_id == 2, "Callback for ERROR");
+
+    assert(FIFOTXT_MSG_TAG(&slot_handle, 0) == 3, "Slot tag +CREG:");
+    assert(FIFOTXT_MSG_TAG(&slot_handle, 1) == FIFOTXT_NO_MATCH, "Slot tag RING");
+    assert(FIFOTXT_MSG_TAG(&slot_handle, 2) == 2, "Slot tag ERROR");
+    assert(FIFOTXT_MSG_TAG(&slot_handle, 3) == FIFOTXT_NO_MATCH, "Slot tag of no message");
+
+    create_fifotxt(&packed_handle);
+
+    push_str(&packed_handle, "OK\r\n");
+    push_str(&packed_handle, "+CRC\r\n");
+    push_str(&packed_handle, "RING\r\n");
+
+    assert(FIFOTXT_CMP_FIRST_MSG(&packed_handle, "OK"), "Packed first with tag");
+    assert(FIFOTXT_CMP_LAST_MSG(&packed_handle, "RING"), "Packed last with tag");
+    assert(FIFOTXT_MSG_TAG(&packed_handle, 0) == 1, "Packed tag OK");
+    assert(FIFOTXT_MSG_TAG(&packed_handle, 1) == 4, "Packed tag +CR");
+    assert(FIFOTXT_MSG_TAG(&packed_handle, 2) == FIFOTXT_NO_MATCH, "Packed tag RING");
+
+    FIFOTXT_DISCARD_MSG(&packed_handle);
+    assert(FIFOTXT_MSG_TAG(&packed_handle, 0) == 4, "Packed tag after discard");
+}
+
+
+/**
+ *
+ */
+static void fifotxt_binary_seq_test(void)
+{
+    static const uint8_t crlf[] = { '\r', '\n' };
+    static const uint8_t chunk[] = { 'A', '\r', 'B', '\0', '\r', '\r', '\n', '\r', '\n', 'L', 'O', 'N', 'G', 'L',
+                                     'O', 'N', 'G', '\r', '\n', 0x55, '\r' };
+    const uint8_t *msg;
+    uint8_t queue[32];
+    uint8_t fbuf[8];
+    uint16_t msgs;
+    uint16_t len;
+
+    __fifotxt_queue test_fqueue = {
+        .queue = queue,
+        .size = sizeof(queue)
+    };
+
+    __fifotxt_buffer test_fbuf = {
+        .buf = fbuf,
+        .size = sizeof(fbuf)
+    };
+
+    __fifotxt_handle handle = {
+        .END_TOKEN = FIFOTXT_TERMINATOR,
+        .PACKED = true,
+        .END_SEQ = crlf,
+        .END_SEQ_LEN = sizeof(crlf),
+        .BINARY = true,
+        .fqueue = &test_fqueue,
+        .fbuf = &test_fbuf
+    };
+
+    PRINT_TEST_NAME(fifotxt_binary_seq_test\r\n);
+
+    create_fifotxt(&handle);
+
+    /* the empty message is skipped, the long one is dropped */
+    msgs = FIFOTXT_PUSH_BYTES(&handle, chunk, sizeof(chunk));
+    assert(msgs == 1, "Binary seq should complete 1 message");
+    assert(handle.fbuf->match == 1, "Binary seq should match a part of delimiter");
+
+    FIFOTXT_PUSH_BYTE(&handle, '\n');
+
+    msg = FIFOTXT_PEEK_MSG(&handle, 0, &len);
+    assert(msg && len == 5 && mem_cmp(msg, "A\rB\0\r", 5), "Binary message with NUL and CR");
+
+    msg = FIFOTXT_PEEK_MSG(&handle, 1, &len);
+    assert(msg && len == 1 && msg[0] == 0x55, "Binary message after the long one");
+
+    assert(FIFOTXT_PEEK_MSG(&handle, 2, &len) == NULL, "Binary seq should have 2 messages");
+}
+
+
+/**
+ *
+ */
+static void fifotxt_overflow_test(void)
+{
+    static const uint8_t crlf[] = { '\r', '\n' };
+    uint8_t queue[12];
+    uint8_t fbuf[8];
+    uint8_t buf[8];
+    uint16_t len;
+
+    __fifotxt_queue oldest_fqueue = {
+        .queue = queue,
+        .size = sizeof(queue)
+    };
+
+    __fifotxt_queue truncate_fqueue = {
+        .queue = queue,
+        .size = sizeof(queue)
+    };
+
+    __fifotxt_queue small_fqueue = {
+        .queue = queue,
+        .size = 6
+    };
+
+    __fifotxt_buffer test_fbuf = {
+        .buf = fbuf,
+        .size = sizeof(fbuf)
+    };
+
+    __fifotxt_handle oldest = {
+        .END_TOKEN = FIFOTXT_TERMINATOR,
+        .IGNORED_TOKEN = FIFOTXT_IGNORED,
+        .PACKED = true,
+        .OVERFLOW_POLICY = FIFOTXT_DROP_OLDEST,
+        .fqueue = &oldest_fqueue,
+        .fbuf = &test_fbuf
+    };
+
+    __fifotxt_handle small = {
+        .END_TOKEN = FIFOTXT_TERMINATOR,
+        .IGNORED_TOKEN = FIFOTXT_IGNORED,
+        .PACKED = true,
+        .OVERFLOW_POLICY = FIFOTXT_DROP_OLDEST,
+        .fqueue = &small_fqueue,
+        .fbuf = &test_fbuf
+    };
+
+    __fifotxt_handle truncate = {
+        .PACKED = true,
+        .END_SEQ = crlf,
+        .END_SEQ_LEN = sizeof(crlf),
+        .OVERFLOW_POLICY = FIFOTXT_TRUNCATE,
+        .fqueue = &truncate_fqueue,
+        .fbuf = &test_fbuf
+    };
+
+    PRINT_TEST_NAME(fifotxt_overflow_test\r\n);
+
+    /* 5 + 5 bytes, the third message needs 2 old ones to be dropped */
+    create_fifotxt(&oldest);
+
+    push_str(&oldest, "AT1\r");
+    push_str(&oldest, "AT2\r");
+    push_str(&oldest, "ERROR\r");
+
+    assert(oldest.fqueue->dropped_oldest == 2 && oldest.fqueue->dropped_newest == 0, "Drop oldest counters");
+    assert(FIFOTXT_CMP_FIRST_MSG(&oldest, "ERROR"), "Drop oldest keeps the newest");
+
+    push_str(&oldest, "ABCDEF\r");
+    assert(oldest.fqueue->dropped_oldest == 3, "Drop oldest counter");
+    assert(FIFOTXT_CMP_FIRST_MSG(&oldest, "ABCDEF") && FIFOTXT_CMP_LAST_MSG(&oldest, "ABCDEF"), "Drop oldest keeps the newest");
+
+    /* 8 bytes never fit in the queue of 6 bytes, the old message is kept */
+    create_fifotxt(&small);
+
+    push_str(&small, "AT\r");
+    push_str(&small, "ABCDEF\r");
+
+    assert(small.fqueue->dropped_oldest == 0 && small.fqueue->dropped_newest == 1, "Too long message is dropped");
+    assert(FIFOTXT_CMP_FIRST_MSG(&small, "AT") && FIFOTXT_CMP_LAST_MSG(&small, "AT"), "Old message is kept");
+
+    /* the long line and the full queue are cut */
+    create_fifotxt(&truncate);
+
+    push_str(&truncate, "LONGLINE\r\n");
+    len = FIFOTXT_POP_MSG(&truncate, buf);
+    assert(len == 7 && str_cmp((const char *)buf, "LONGLIN"), "Long line is truncated");
+
+    /* 8 bytes are taken, 4 are free */
+    push_str(&truncate, "ABCDEF\r\n");
+    push_str(&truncate, "GHIJ\r\n");
+    assert(truncate.fqueue->truncated == 2, "Truncate counter");
+
+    FIFOTXT_DISCARD_MSG(&truncate);
+    len = FIFOTXT_POP_MSG(&truncate, buf);
+    assert(len == 2 && str_cmp((const char *)buf, "GH"), "Message is truncated to the free space");
+}
+
+
+/**
+ *
+ */
+static void fifotxt_idle_test(void)
+{
+    uint8_t queue[16];
+    uint8_t fbuf[8];
+
+    __fifotxt_queue test_fqueue = {
+        .queue = queue,
+        .size = sizeof(queue)
+    };
+
+    __fifotxt_buffer test_fbuf = {
+        .buf = fbuf,
+        .size = sizeof(fbuf)
+    };
+
+    __fifotxt_handle handle = {
+        .END_TOKEN = FIFOTXT_TERMINATOR,
+        .IGNORED_TOKEN = FIFOTXT_IGNORED,
+        .PACKED = true,
+        .timestamp = test_timestamp,
+        .IDLE_GAP = 10,
+        .fqueue = &test_fqueue,
+        .fbuf = &test_fbuf
+    };
+
+    PRINT_TEST_NAME(fifotxt_idle_test\r\n);
+
+    create_fifotxt(&handle);
+    test_ticks = 100;
+
+    assert(!FIFOTXT_POLL_IDLE(&handle), "Nothing to flush");
+
+    push_str(&handle, "> ");
+
+    test_ticks += 9;
+    assert(!FIFOTXT_POLL_IDLE(&handle) && !FIFOTXT_IS_FIFO_NOT_EMPTY(&handle), "Gap is not reached");
+
+    test_ticks += 1;
+    assert(FIFOTXT_POLL_IDLE(&handle), "Gap is reached");
+    assert(FIFOTXT_CMP_FIRST_MSG(&handle, "> "), "Prompt is queued");
+    assert(!FIFOTXT_POLL_IDLE(&handle), "Nothing to flush after gap");
+}
+
+
+/**
+ *
+ */
+static uint32_t test_timestamp(void)
+{
+    return test_ticks;
+}
+
+
+/**
+ *
+ */
+static void on_match_test(__fifotxt_handle * const fh, const uint8_t id, const uint8_t * const msg, const uint16_t len)
+{
+    uint16_t last_len;
+
+    /* the message is already queued */
+    match_msg_ok = fifotxt_peek_msg(fh, fh->fqueue->index - 1, &last_len) == msg && last_len == len;
+
+    last_match_id = id;
+    match_cnt++;
+}
+
+
+/**
+ *
+ */
+static void push_str(__fifotxt_handle *handle, const char *str)
+{
+    while (*str) {
+        FIFOTXT_PUSH_BYTE(handle, (uint8_t)*str++);
+    }
+}
 
@@ -10,9 +10,47 @@
 
 
 
+/**
+ * Private macros
+ *
+ * SWAR: a word has a zero byte if (w - 0x01..) & ~w & 0x80.. is not zero
+ */
+#define FT_SWAR_ONES                    0x01010101UL
+#define FT_SWAR_HIGHS                   0x80808080UL
+#define FT_SWAR_HAS_ZERO(w)             ((((w) - FT_SWAR_ONES) & ~(w) & FT_SWAR_HIGHS) != 0)
+
+#define FT_IS_SPECIAL(s,b)              ((b) == (s)[0] || (b) == (s)[1] || (b) == (s)[2])
+
+/* the delimiter sequence: END_SEQ, or END_TOKEN in the binary mode without END_SEQ */
+#define FT_SEQ_MODE(fh)                 ((fh)->END_SEQ_LEN || (fh)->BINARY)
+#define FT_SEQ(fh)                      ((fh)->END_SEQ_LEN ? (fh)->END_SEQ : &(fh)->END_TOKEN)
+#define FT_SEQ_LEN(fh)                  ((fh)->END_SEQ_LEN ? (fh)->END_SEQ_LEN : 1)
+
+/* the packed message keeps its pattern id after the length header */
+#define FT_TAG_SIZE(fh)                 ((fh)->matcher ? 1 : 0)
+
+
+
 
 static uint8_t *__next_fifo_cell(__fifotxt_handle * const fh);
-static void __add_msg_in_queue(__fifotxt_handle * const fh);
+static void __add_msg_in_queue(__fifotxt_handle * const fh, uint16_t len);
+static uint8_t *__alloc_msg(__fifotxt_handle * const fh, const uint16_t len);
+static bool __fits_empty(__fifotxt_handle * const fh, const uint16_t len);
+static void __lose_bytes(__fifotxt_buffer * const fbuf, const uint16_t cnt);
+static void __touch(__fifotxt_handle * const fh);
+static bool __push_seq_byte(__fifotxt_handle * const fh, const uint8_t byte);
+static uint8_t __seq_next(const uint8_t * const seq, const uint8_t match, const uint8_t byte);
+static uint16_t __plain_run(const uint8_t * const src, const uint16_t len, const uint8_t * const special);
+
+static uint8_t *__msg_at(__fifotxt_handle * const fh, uint16_t n, uint16_t * const len);
+static uint8_t *__last_msg(__fifotxt_handle * const fh, uint16_t * const len);
+static uint16_t __slot_len(__fifotxt_handle * const fh, const uint16_t idx);
+static void __drop_first_msg(__fifotxt_handle * const fh);
+
+static uint8_t __packed_header(__fifotxt_handle * const fh, const uint8_t * const cell, uint16_t * const len);
+static void __tag_msg(__fifotxt_handle * const fh, uint8_t * const msg, const uint16_t len);
+static uint8_t *__packed_alloc(__fifotxt_queue * const fqueue, const uint16_t need);
+static uint16_t __packed_fit(__fifotxt_handle * const fh, const uint16_t len);
 
 
 
@@ -22,8 +60,16 @@ static void __add_msg_in_queue(__fifotxt_handle * const fh);
 void create_fifotxt(__fifotxt_handle * const fh)
 {
     fh->fbuf->index = 0;
+    fh->fbuf->match = 0;
+    fh->fbuf->lost = 0;
+    fh->fbuf->last_ts = 0;
     fh->fqueue->index = 0;
     fh->fqueue->first = 0;
+    fh->fqueue->tail = 0;
+    fh->fqueue->last = 0;
+    fh->fqueue->dropped_newest = 0;
+    fh->fqueue->dropped_oldest = 0;
+    fh->fqueue->truncated = 0;
 }
 
 
@@ -34,7 +80,11 @@ void fifotxt_flush_fifo(__fifotxt_handle * const fh)
 {
     fh->fqueue->index = 0;
     fh->fqueue->first = 0;
+    fh->fqueue->tail = 0;
+    fh->fqueue->last = 0;
     fh->fbuf->index = 0;
+    fh->fbuf->match = 0;
+    fh->fbuf->lost = 0;
 }
 
 
@@ -52,13 +102,11 @@ bool is_fifotxt_not_empty(__fifotxt_handle * const fh)
  */
 bool fifotxt_cmp_last_msg(__fifotxt_handle * const fh, const char * msg)
 {
-    if (fh->fqueue->index) {
-        const uint16_t sum = fh->fqueue->first + (fh->fqueue->index - 1);
-        const uint16_t last_idx = sum < fh->fqueue->size ? sum : sum - fh->fqueue->size;
-
-        uint8_t  *last_msg = fh->fqueue->queue + (last_idx * fh->fbuf->size);
+    uint16_t len;
+    uint8_t *last_msg = __last_msg(fh, &len);
 
-        return str_cmp((const char *)last_msg, msg);
+    if (last_msg) {
+        return mem_cmp(last_msg, msg, len);
     }
 
     return false;
@@ -70,11 +118,11 @@ bool fifotxt_cmp_last_msg(__fifotxt_handle * const fh, const char * msg)
  */
 bool fifotxt_cmp_first_msg(__fifotxt_handle * const fh, const char * msg)
 {
-    if (fh->fqueue->index) {
-
-        uint8_t *first_msg = fh->fqueue->queue + (fh->fqueue->first * fh->fbuf->size);
+    uint16_t len;
+    uint8_t *first_msg = __msg_at(fh, 0, &len);
 
-        return str_cmp((const char *)first_msg, (const char *)msg);
+    if (first_msg) {
+        return mem_cmp(first_msg, msg, len);
     }
 
     return false;
@@ -86,13 +134,19 @@ bool fifotxt_cmp_first_msg(__fifotxt_handle * const fh, const char * msg)
  */
 bool fifotxt_push_byte(__fifotxt_handle * const fh, const uint8_t byte)
 {
+    __touch(fh);
+
+    if (FT_SEQ_MODE(fh)) {
+        return __push_seq_byte(fh, byte);
+    }
+
     if (fh->fbuf->index < fh->fbuf->size) {
 
         if (fh->fbuf->index > 0 &&  byte != '\0' && byte != fh->IGNORED_TOKEN) {
             if (fh->END_TOKEN == byte) {
 
                 fh->fbuf->buf[fh->fbuf->index++] = 0;
-                __add_msg_in_queue(fh);
+                __add_msg_in_queue(fh, fh->fbuf->index - 1);
 
                 return true;
             } else {
@@ -111,14 +165,118 @@ bool fifotxt_push_byte(__fifotxt_handle * const fh, const uint8_t byte)
 }
 
 
+/**
+ *
+ */
+uint16_t fifotxt_push_bytes(__fifotxt_handle * const fh, const uint8_t * const src, const uint16_t len)
+{
+    __fifotxt_buffer * const fbuf = fh->fbuf;
+    uint8_t special[3];
+    uint16_t limit;
+    uint16_t pos;
+    uint16_t run;
+    uint16_t room;
+    uint16_t msgs;
+
+    /* bytes which change state, the rest is copied by runs */
+    if (!FT_SEQ_MODE(fh)) {
+        special[0] = '\0';
+        special[1] = fh->END_TOKEN;
+        special[2] = fh->IGNORED_TOKEN;
+        limit = fbuf->size;
+    } else {
+        special[0] = fh->BINARY ? FT_SEQ(fh)[0] : '\0';
+        special[1] = FT_SEQ(fh)[0];
+        special[2] = fh->BINARY ? FT_SEQ(fh)[0] : fh->IGNORED_TOKEN;
+        limit = fbuf->size - 1;
+    }
+
+    pos = 0;
+    msgs = 0;
+
+    if (len) {
+        __touch(fh);
+    }
+
+    while (pos < len) {
+        /* a partial delimiter is matched byte by byte */
+        run = fbuf->match ? 0 : __plain_run(src + pos, len - pos, special);
+
+        if (run) {
+            /* the bytes over the buffer are lost like in "fifotxt_push_byte" */
+            room = fbuf->index < limit ? limit - fbuf->index : 0;
+
+            if (run > room) {
+                /* the overflow policy is applied in the sequence mode */
+                if (FT_SEQ_MODE(fh)) {
+                    __lose_bytes(fbuf, run - room);
+                }
+            } else {
+                room = run;
+            }
+
+            mem_copy(fbuf->buf + fbuf->index, src + pos, room);
+            fbuf->index += room;
+
+            if (fbuf->index < fbuf->size) {
+                fbuf->buf[fbuf->index] = 0;
+            }
+
+            pos += run;
+        }
+
+        if (pos < len && fifotxt_push_byte(fh, src[pos++])) {
+            msgs++;
+        }
+    }
+
+    return msgs;
+}
+
+
 /**
  *
  */
 void fifotxt_push_msg(__fifotxt_handle * const fh)
 {
-    if (fh->fbuf->index) {
-        __add_msg_in_queue(fh);
+    __fifotxt_buffer * const fbuf = fh->fbuf;
+
+    fbuf->match = 0;
+
+    if (fbuf->lost) {
+        fbuf->lost = 0;
+
+        if (fh->OVERFLOW_POLICY != FIFOTXT_TRUNCATE) {
+            fh->fqueue->dropped_newest++;
+            fbuf->index = 0;
+            return;
+        }
+
+        fh->fqueue->truncated++;
+    }
+
+    if (fbuf->index) {
+        __add_msg_in_queue(fh, fbuf->index);
+    }
+}
+
+
+/**
+ *
+ */
+bool fifotxt_poll_idle(__fifotxt_handle * const fh)
+{
+    if (!fh->timestamp || !fh->IDLE_GAP || !fh->fbuf->index) {
+        return false;
+    }
+
+    if (fh->timestamp() - fh->fbuf->last_ts < fh->IDLE_GAP) {
+        return false;
     }
+
+    fifotxt_push_msg(fh);
+
+    return true;
 }
 
 
@@ -128,16 +286,13 @@ void fifotxt_push_msg(__fifotxt_handle * const fh)
 uint16_t fifotxt_pop_msg(__fifotxt_handle * const fh, uint8_t * in)
 {
     uint16_t len;
+    uint8_t * msg = __msg_at(fh, 0, &len);
 
-    if (fh->fqueue->index > 0) {
-        uint8_t * msg = fh->fqueue->queue + (fh->fqueue->first * fh->fbuf->size);
+    if (msg) {
+        mem_copy(in, msg, len);
+        in[len] = 0;
 
-        len = str_copy(in, (const char *)msg);
-
-        if (--fh->fqueue->index > 0) {
-            fh->fqueue->first = (fh->fqueue->first + 1 < fh->fqueue->size)
-                    ? fh->fqueue->first + 1 : 0;
-        }
+        __drop_first_msg(fh);
 
     } else {
         len = 0;
@@ -151,18 +306,148 @@ uint16_t fifotxt_pop_msg(__fifotxt_handle * const fh, uint8_t * in)
 /**
  *
  */
-void fifotxt_discard_msg(__fifotxt_handle * const fh)
+const uint8_t *fifotxt_peek_msg(__fifotxt_handle * const fh, const uint16_t n, uint16_t * const len)
 {
-    if (fh->fqueue->index) {
-        fh->fqueue->index--;
+    const uint8_t * msg = __msg_at(fh, n, len);
 
-        if (fh->fqueue->index) {
-            fh->fqueue->first = (fh->fqueue->first + 1 < fh->fqueue->size)
-                    ? fh->fqueue->first + 1 : 0;
-        } else {
-            fh->fqueue->first = 0;
+    if (!msg) {
+        *len = 0;
+    }
+
+    return msg;
+}
+
+
+/**
+ *
+ */
+uint8_t fifotxt_msg_tag(__fifotxt_handle * const fh, const uint16_t n)
+{
+    uint16_t len;
+    const uint8_t * msg = __msg_at(fh, n, &len);
+
+    if (!msg || !fh->matcher) {
+        return FIFOTXT_NO_MATCH;
+    }
+
+    if (fh->PACKED) {
+        return msg[-1];
+    }
+
+    if (fh->fqueue->tags) {
+        return fh->fqueue->tags[(msg - fh->fqueue->queue) / fh->fbuf->size];
+    }
+
+    return fifotxt_match(fh->matcher, msg, len);
+}
+
+
+/**
+ *
+ */
+bool fifotxt_matcher_compile(__fifotxt_matcher * const matcher, const char * const * patterns, const uint8_t cnt)
+{
+    __fifotxt_trie_node * const nodes = matcher->nodes;
+    const char * p;
+    uint16_t node;
+    uint16_t next;
+    uint8_t i;
+
+    if (!matcher->size) {
+        return false;
+    }
+
+    /* the root, 0 is "no node" for links since the root is never a child */
+    nodes[0].byte = 0;
+    nodes[0].id = FIFOTXT_NO_MATCH;
+    nodes[0].child = 0;
+    nodes[0].sibling = 0;
+    matcher->count = 1;
+
+    for (i = 0; i < cnt; i++) {
+        p = patterns[i];
+        node = 0;
+
+        if (!*p) {
+            return false;
+        }
+
+        for (; *p; p++) {
+            next = nodes[node].child;
+
+            while (next && nodes[next].byte != (uint8_t)*p) {
+                next = nodes[next].sibling;
+            }
+
+            if (!next) {
+                if (matcher->count >= matcher->size) {
+                    return false;
+                }
+
+                next = matcher->count++;
+
+                nodes[next].byte = (uint8_t)*p;
+                nodes[next].id = FIFOTXT_NO_MATCH;
+                nodes[next].child = 0;
+                nodes[next].sibling = nodes[node].child;
+                nodes[node].child = next;
+            }
+
+            node = next;
+        }
+
+        /* the first of duplicates wins */
+        if (nodes[node].id == FIFOTXT_NO_MATCH) {
+            nodes[node].id = i + 1;
         }
     }
+
+    return true;
+}
+
+
+/**
+ *
+ */
+uint8_t fifotxt_match(const __fifotxt_matcher * const matcher, const uint8_t * const msg, const uint16_t len)
+{
+    const __fifotxt_trie_node * const nodes = matcher->nodes;
+    uint16_t node;
+    uint16_t next;
+    uint16_t i;
+    uint8_t id;
+
+    node = 0;
+    id = FIFOTXT_NO_MATCH;
+
+    for (i = 0; i < len; i++) {
+        next = nodes[node].child;
+
+        while (next && nodes[next].byte != msg[i]) {
+            next = nodes[next].sibling;
+        }
+
+        if (!next) {
+            break;
+        }
+
+        node = next;
+
+        if (nodes[node].id != FIFOTXT_NO_MATCH) {
+            id = nodes[node].id;
+        }
+    }
+
+    return id;
+}
+
+
+/**
+ *
+ */
+void fifotxt_discard_msg(__fifotxt_handle * const fh)
+{
+    __drop_first_msg(fh);
 }
 
 
@@ -181,19 +466,505 @@ static uint8_t *__next_fifo_cell(__fifotxt_handle * const fh)
 /**
  *
  */
-static void __add_msg_in_queue(__fifotxt_handle * const fh)
+static void __add_msg_in_queue(__fifotxt_handle * const fh, uint16_t len)
+{
+    __fifotxt_queue * const fqueue = fh->fqueue;
+    uint8_t * msg;
+
+    if (len && fh->fbuf->index > 0 && fh->fbuf->index < fh->fbuf->size) {
+
+        msg = __alloc_msg(fh, len);
+
+        /* don't evict anything for the message which never fits */
+        if (!msg && fh->OVERFLOW_POLICY == FIFOTXT_DROP_OLDEST && __fits_empty(fh, len)) {
+            while (!msg && fqueue->index) {
+                __drop_first_msg(fh);
+                fqueue->dropped_oldest++;
+
+                msg = __alloc_msg(fh, len);
+            }
+
+        } else if (!msg && fh->OVERFLOW_POLICY == FIFOTXT_TRUNCATE && fh->PACKED) {
+            len = __packed_fit(fh, len);
+
+            if (len) {
+                msg = __alloc_msg(fh, len);
+                fqueue->truncated++;
+            }
+        }
+
+        if (msg) {
+            mem_copy(msg, fh->fbuf->buf, len);
+            msg[len] = 0;
+
+            fqueue->index++;
+
+            __tag_msg(fh, msg, len);
+        } else {
+            fqueue->dropped_newest++;
+        }
+    }
+
+    fh->fbuf->index = 0;
+}
+
+
+/**
+ * @brief Take space for message in the queue, the length is stored
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @param len - length of message
+ * @return pointer on message or NULL if the queue is full
+ */
+static uint8_t *__alloc_msg(__fifotxt_handle * const fh, const uint16_t len)
 {
+    __fifotxt_queue * const fqueue = fh->fqueue;
     uint8_t * cell;
+    uint8_t hdr;
 
-    if (fh->fqueue->index < fh->fqueue->size
-            && fh->fbuf->index > 0 && fh->fbuf->index < fh->fbuf->size) {
+    if (!fh->PACKED) {
+        if (fqueue->index >= fqueue->size) {
+            return NULL;
+        }
 
         cell = __next_fifo_cell(fh);
-        str_copy(cell, (const char *)fh->fbuf->buf);
 
-        fh->fqueue->index++;
+        if (fqueue->lens) {
+            fqueue->lens[(cell - fqueue->queue) / fh->fbuf->size] = len;
+        }
+
+        return cell;
     }
 
-    fh->fbuf->index = 0;
+    hdr = (len < 0x80 ? 1 : 2) + FT_TAG_SIZE(fh);
+
+    if (len > FIFOTXT_PACKED_MAX_LEN || (cell = __packed_alloc(fqueue, hdr + len + 1)) == NULL) {
+        return NULL;
+    }
+
+    if (len < 0x80) {
+        cell[0] = (uint8_t)len;
+    } else {
+        cell[0] = (uint8_t)(0x80 | (len >> 8));
+        cell[1] = (uint8_t)len;
+    }
+
+    return cell + hdr;
+}
+
+
+/**
+ * @brief Check the message fits in the empty queue
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @param len - length of message
+ * @return false if the message is too long for the queue
+ */
+static bool __fits_empty(__fifotxt_handle * const fh, const uint16_t len)
+{
+    if (!fh->PACKED) {
+        return true;
+    }
+
+    return len <= FIFOTXT_PACKED_MAX_LEN
+            && (uint32_t)(len < 0x80 ? 1 : 2) + FT_TAG_SIZE(fh) + len + 1 <= fh->fqueue->size;
+}
+
+
+/**
+ * @brief Count bytes of message which don't fit in the buffer
+ *
+ * @param fbuf - pointer on the buffer
+ * @param cnt - count of lost bytes
+ */
+static void __lose_bytes(__fifotxt_buffer * const fbuf, const uint16_t cnt)
+{
+    const uint32_t lost = (uint32_t)fbuf->lost + cnt;
+
+    fbuf->lost = lost < 0xFFFF ? (uint16_t)lost : 0xFFFF;
+}
+
+
+/**
+ * @brief Save time of the received byte for the idle gap
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ */
+static void __touch(__fifotxt_handle * const fh)
+{
+    if (fh->timestamp && fh->IDLE_GAP) {
+        fh->fbuf->last_ts = fh->timestamp();
+    }
+}
+
+
+/**
+ * @brief Push a byte in the sequence or binary mode
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @param byte - received byte
+ * @return true if the delimiter is completed
+ */
+static bool __push_seq_byte(__fifotxt_handle * const fh, const uint8_t byte)
+{
+    __fifotxt_buffer * const fbuf = fh->fbuf;
+    const uint8_t seq_len = FT_SEQ_LEN(fh);
+    uint16_t len;
+
+    if (!fh->BINARY && (byte == '\0' || byte == fh->IGNORED_TOKEN)) {
+        return false;
+    }
+
+    /* one byte is kept for the terminator */
+    if (fbuf->index < fbuf->size - 1) {
+        fbuf->buf[fbuf->index++] = byte;
+        fbuf->buf[fbuf->index] = 0;
+    } else {
+        __lose_bytes(fbuf, 1);
+    }
+
+    fbuf->match = __seq_next(FT_SEQ(fh), fbuf->match, byte);
+
+    if (fbuf->match < seq_len) {
+        return false;
+    }
+
+    fbuf->match = 0;
+
+    /* the delimiter is stored partly or not at all if the buffer is full */
+    len = fbuf->index - (fbuf->lost < seq_len ? seq_len - fbuf->lost : 0);
+
+    if (fbuf->lost > seq_len) {
+        fbuf->lost = 0;
+
+        if (fh->OVERFLOW_POLICY != FIFOTXT_TRUNCATE) {
+            fh->fqueue->dropped_newest++;
+            fbuf->index = 0;
+            return false;
+        }
+
+        fh->fqueue->truncated++;
+    }
+
+    fbuf->lost = 0;
+
+    fbuf->buf[len] = 0;
+
+    __add_msg_in_queue(fh, len);
+
+    return len > 0;
+}
+
+
+/**
+ * @brief Get count of matched bytes of the delimiter after the next byte.
+ *        The matched bytes are the prefix of delimiter, so the fallback
+ *        is found in the delimiter itself.
+ *
+ * @param seq - delimiter
+ * @param match - count of matched bytes, less than length of delimiter
+ * @param byte - next byte
+ * @return count of matched bytes
+ */
+static uint8_t __seq_next(const uint8_t * const seq, const uint8_t match, const uint8_t byte)
+{
+    uint8_t k;
+
+    if (seq[match] == byte) {
+        return match + 1;
+    }
+
+    for (k = match; k > 0; k--) {
+        if (seq[k - 1] == byte && mem_cmp(seq, seq + match - (k - 1), k - 1)) {
+            return k;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * @brief Get count of leading bytes which are not in "special".
+ *        Aligned words are checked for all three at once.
+ *
+ * @param src - data
+ * @param len - length of data
+ * @param special - 3 bytes which stop the run
+ * @return count of plain bytes
+ */
+static uint16_t __plain_run(const uint8_t * const src, const uint16_t len, const uint8_t * const special)
+{
+    const uint32_t s0 = (uint32_t)(FT_SWAR_ONES * special[0]);
+    const uint32_t s1 = (uint32_t)(FT_SWAR_ONES * special[1]);
+    const uint32_t s2 = (uint32_t)(FT_SWAR_ONES * special[2]);
+    uint32_t word;
+    uint16_t run;
+
+    run = 0;
+
+    while (run < len && ((uintptr_t)(src + run) & 3)) {
+        if (FT_IS_SPECIAL(special, src[run])) {
+            return run;
+        }
+        run++;
+    }
+
+    while (len - run >= 4) {
+        /* the aligned word, the constant size copy is one load */
+        __builtin_memcpy(&word, src + run, 4);
+
+        if (FT_SWAR_HAS_ZERO(word ^ s0) || FT_SWAR_HAS_ZERO(word ^ s1) || FT_SWAR_HAS_ZERO(word ^ s2)) {
+            break;
+        }
+        run += 4;
+    }
+
+    while (run < len && !FT_IS_SPECIAL(special, src[run])) {
+        run++;
+    }
+
+    return run;
+}
+
+
+/**
+ * @brief Get the message by number
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @param n - number of message, 0 - the first
+ * @param len - length of message
+ * @return pointer on message or NULL if there is no such message
+ */
+static uint8_t *__msg_at(__fifotxt_handle * const fh, uint16_t n, uint16_t * const len)
+{
+    __fifotxt_queue * const fqueue = fh->fqueue;
+    uint16_t pos;
+    uint8_t hdr;
+
+    if (n >= fqueue->index) {
+        return NULL;
+    }
+
+    if (!fh->PACKED) {
+        pos = fqueue->first + n;
+        pos = pos < fqueue->size ? pos : pos - fqueue->size;
+
+        *len = __slot_len(fh, pos);
+
+        return fqueue->queue + (pos * fh->fbuf->size);
+    }
+
+    pos = fqueue->first;
+
+    while (n--) {
+        hdr = __packed_header(fh, fqueue->queue + pos, len);
+        pos += hdr + *len + 1;
+
+        if (pos >= fqueue->size || !fqueue->queue[pos]) {
+            pos = 0;
+        }
+    }
+
+    return fqueue->queue + pos + __packed_header(fh, fqueue->queue + pos, len);
+}
+
+
+/**
+ * @brief Get the last message
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @param len - length of message
+ * @return pointer on message or NULL if the queue is empty
+ */
+static uint8_t *__last_msg(__fifotxt_handle * const fh, uint16_t * const len)
+{
+    if (!fh->fqueue->index) {
+        return NULL;
+    }
+
+    if (!fh->PACKED) {
+        return __msg_at(fh, fh->fqueue->index - 1, len);
+    }
+
+    return fh->fqueue->queue + fh->fqueue->last
+            + __packed_header(fh, fh->fqueue->queue + fh->fqueue->last, len);
+}
+
+
+/**
+ * @brief Get length of message in the slot, it is counted if lengths are not stored
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @param idx - index of slot
+ * @return length of message
+ */
+static uint16_t __slot_len(__fifotxt_handle * const fh, const uint16_t idx)
+{
+    if (fh->fqueue->lens) {
+        return fh->fqueue->lens[idx];
+    }
+
+    return (uint16_t)str_len((const char *)(fh->fqueue->queue + (idx * fh->fbuf->size)));
+}
+
+
+/**
+ *
+ */
+static void __drop_first_msg(__fifotxt_handle * const fh)
+{
+    __fifotxt_queue * const fqueue = fh->fqueue;
+    uint16_t len;
+    uint8_t hdr;
+
+    if (!fqueue->index) {
+        return;
+    }
+
+    fqueue->index--;
+
+    if (!fqueue->index) {
+        fqueue->first = 0;
+        fqueue->tail = 0;
+        fqueue->last = 0;
+
+    } else if (!fh->PACKED) {
+        fqueue->first = (fqueue->first + 1 < fqueue->size) ? fqueue->first + 1 : 0;
+
+    } else {
+        hdr = __packed_header(fh, fqueue->queue + fqueue->first, &len);
+        fqueue->first += hdr + len + 1;
+
+        /* the end of queue or the wrap mark, the next message is at the start */
+        if (fqueue->first >= fqueue->size || !fqueue->queue[fqueue->first]) {
+            fqueue->first = 0;
+        }
+    }
+}
+
+
+/**
+ * @brief Parse the length header of packed message
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @param cell - pointer on the header
+ * @param len - length of message
+ * @return size of header with the pattern id
+ */
+static uint8_t __packed_header(__fifotxt_handle * const fh, const uint8_t * const cell, uint16_t * const len)
+{
+    if (cell[0] & 0x80) {
+        *len = (uint16_t)(((cell[0] & 0x7F) << 8) | cell[1]);
+        return 2 + FT_TAG_SIZE(fh);
+    }
+
+    *len = cell[0];
+    return 1 + FT_TAG_SIZE(fh);
+}
+
+
+/**
+ * @brief Classify the queued message: store its pattern id and call "on_match"
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @param msg - pointer on message in the queue
+ * @param len - length of message
+ */
+static void __tag_msg(__fifotxt_handle * const fh, uint8_t * const msg, const uint16_t len)
+{
+    uint8_t id;
+
+    if (!fh->matcher) {
+        return;
+    }
+
+    id = fifotxt_match(fh->matcher, msg, len);
+
+    if (fh->PACKED) {
+        msg[-1] = id;
+    } else if (fh->fqueue->tags) {
+        fh->fqueue->tags[(msg - fh->fqueue->queue) / fh->fbuf->size] = id;
+    }
+
+    if (fh->on_match && id != FIFOTXT_NO_MATCH) {
+        fh->on_match(fh, id, msg, len);
+    }
+}
+
+
+/**
+ * @brief Get length of message cut to the largest contiguous free space
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @param len - length of message
+ * @return length of the cut message, 0 if there is no space
+ */
+static uint16_t __packed_fit(__fifotxt_handle * const fh, const uint16_t len)
+{
+    __fifotxt_queue * const fqueue = fh->fqueue;
+    uint16_t room;
+    uint16_t fit;
+
+    if (!fqueue->index) {
+        room = fqueue->size;
+    } else if (fqueue->tail > fqueue->first) {
+        room = fqueue->size - fqueue->tail;
+        room = fqueue->first > room ? fqueue->first : room;
+    } else {
+        room = fqueue->first - fqueue->tail;
+    }
+
+    /* header, id and terminator */
+    if (room < 3 + FT_TAG_SIZE(fh)) {
+        return 0;
+    }
+
+    fit = room - 2 - FT_TAG_SIZE(fh);
+
+    if (fit >= 0x80) {
+        fit--;
+    }
+
+    fit = fit < FIFOTXT_PACKED_MAX_LEN ? fit : FIFOTXT_PACKED_MAX_LEN;
+
+    return len < fit ? len : fit;
+}
+
+
+/**
+ * @brief Take contiguous space for packed message
+ *
+ * @param fqueue - pointer on the queue
+ * @param need - size of header, message and terminator
+ * @return pointer on the space or NULL if the queue is full
+ */
+static uint8_t *__packed_alloc(__fifotxt_queue * const fqueue, const uint16_t need)
+{
+    uint16_t at;
+
+    if (!fqueue->index || fqueue->tail > fqueue->first) {
+        /* free space is [tail, size) and [0, first) */
+        if (fqueue->size - fqueue->tail >= need) {
+            at = fqueue->tail;
+        } else if (fqueue->first >= need) {
+            if (fqueue->tail < fqueue->size) {
+                fqueue->queue[fqueue->tail] = 0;
+            }
+            at = 0;
+        } else {
+            return NULL;
+        }
+    } else if (fqueue->first - fqueue->tail >= need) {
+        /* free space is [tail, first) */
+        at = fqueue->tail;
+    } else {
+        return NULL;
+    }
+
+    fqueue->last = at;
+    fqueue->tail = at + need;
+
+    return fqueue->queue + at;
 }
 
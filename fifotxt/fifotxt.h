@@ -10,6 +10,13 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include <qstat.h>
+
+
+#ifndef NULL
+#define NULL ((void *)0)
+#endif
+
 
 
 /**
@@ -18,53 +25,183 @@
  * @param fh - pointer to the "__fifotxt_handle" structure
  * @param buf - pointer to the buffer were was stored the popped message
  * @param byte - a byte for push in the fifo
+ * @param src - pointer to the received chunk
+ * @param len - length of the chunk
+ * @param n - number of message in the queue, 0 - the first
+ * @param plen - pointer to the length of message
  */
 #define FIFOTXT_IS_FIFO_NOT_EMPTY(fh)    is_fifotxt_not_empty((fh))
 #define FIFOTXT_POP_MSG(fh,buf)          fifotxt_pop_msg((fh),(buf))
+#define FIFOTXT_PEEK_MSG(fh,n,plen)      fifotxt_peek_msg((fh),(n),(plen))
+#define FIFOTXT_MSG_TAG(fh,n)            fifotxt_msg_tag((fh),(n))
 #define FIFOTXT_DISCARD_MSG(fh)          fifotxt_discard_msg((fh))
 #define FIFOTXT_CMP_LAST_MSG(fh,msg)     fifotxt_cmp_last_msg((fh),(msg))
 #define FIFOTXT_CMP_FIRST_MSG(fh,msg)    fifotxt_cmp_first_msg((fh),(msg))
 #define FIFOTXT_PUSH_BYTE(fh,byte)       fifotxt_push_byte((fh),(byte))
+#define FIFOTXT_PUSH_BYTES(fh,src,len)   fifotxt_push_bytes((fh),(src),(len))
 #define FIFOTXT_FLUSH_FIFO(fh)           fifotxt_flush_fifo((fh))
 #define FIFOTXT_PUSH_MSG(fh)             fifotxt_push_msg((fh))
+#define FIFOTXT_POLL_IDLE(fh)            fifotxt_poll_idle((fh))
+
+
+
+/**
+ * Max length of message in the packed mode
+ */
+#define FIFOTXT_PACKED_MAX_LEN           0x7FFF
+
+/**
+ * Pattern id of message which doesn't match any pattern, ids of patterns start from 1
+ */
+#define FIFOTXT_NO_MATCH                 0
+
+
+
+/**
+ * @brief Overflow policy: what to do with the message which doesn't fit
+ *
+ * FIFOTXT_DROP_NEWEST - drop it (default)
+ * FIFOTXT_DROP_OLDEST - discard the oldest messages until it fits
+ * FIFOTXT_TRUNCATE - cut it to the free space of the packed queue; in the sequence
+ *                    mode the message longer than the buffer is cut too
+ */
+typedef enum {
+    FIFOTXT_DROP_NEWEST = 0,
+    FIFOTXT_DROP_OLDEST,
+    FIFOTXT_TRUNCATE
+} __fifotxt_overflow_policy;
 
 
 
 /**
  * @brief Fifo queue
  *
+ * Slot mode (default): "size" slots of "fbuf->size" bytes, "first" is the index of
+ * the first slot.
+ *
+ * Packed mode ("PACKED" of handle): messages sit back-to-back as [header][message][0],
+ * the header is 1 byte if length < 0x80 else 2 bytes. "size" is count of bytes,
+ * "first", "tail" and "last" are byte offsets. A message never wraps: if it doesn't
+ * fit in the end of queue, a zero byte is written there and the message goes
+ * to the start.
+ *
+ * "index" is count of messages in both modes.
+ *
+ * "lens" is optional array of "size" lengths for the slot mode. Without it
+ * the slot mode still counts the length by "str_len" on every access (peek, pop,
+ * cmp), so use "lens" to avoid rescans. The packed mode keeps lengths in headers.
+ *
+ * "tags" is optional array of "size" pattern ids for the slot mode, without it
+ * the id is matched on every access. The packed mode keeps the id after the header
+ * if the handle has a matcher.
+ *
+ * "dropped_newest", "dropped_oldest", "truncated" count messages by overflow policy,
+ * they are cleared by "create_fifotxt" only.
  */
 typedef struct {
     uint8_t * const queue;
     uint16_t index;
     uint16_t first;
     const uint16_t size;
+
+    uint16_t tail;
+    uint16_t last;
+
+    uint16_t * const lens;
+    uint8_t * const tags;
+
+    uint32_t dropped_newest;
+    uint32_t dropped_oldest;
+    uint32_t truncated;
 } __fifotxt_queue;
 
 
 /**
  * @brief Fifo buffer
  *
+ * "match" is count of received bytes of the delimiter sequence,
+ * "lost" is count of bytes of the current message which don't fit in the buffer,
+ * "last_ts" is time of the last received byte.
  */
 typedef struct {
     uint8_t * const buf;
     uint16_t index;
     const uint16_t size;
+
+    uint8_t match;
+    uint16_t lost;
+    uint32_t last_ts;
 } __fifotxt_buffer;
 
 
 
+/**
+ * @brief Node of the pattern trie, links are indexes of nodes, 0 - no link
+ *
+ */
+typedef struct {
+    uint8_t byte;
+    uint8_t id;
+    uint16_t child;
+    uint16_t sibling;
+} __fifotxt_trie_node;
+
+
+/**
+ * @brief Matcher of message prefixes, compiled from a pattern table
+ *        by "fifotxt_matcher_compile". It needs 1 + count of pattern bytes
+ *        nodes at most.
+ *
+ */
+typedef struct {
+    __fifotxt_trie_node * const nodes;
+    const uint16_t size;
+    uint16_t count;
+} __fifotxt_matcher;
+
+
+
 /**
  * @brief Main managed structure
  *
+ * "matcher" (optional) classifies every queued message, "on_match" (optional)
+ * is called for the message which matches a pattern, after it is queued.
+ *
+ * Sequence mode: if "END_SEQ_LEN" is not 0, a message ends by the "END_SEQ" bytes
+ * (e.g. "\r\n"), they are matched as bytes come in and are not stored. NUL and
+ * IGNORED_TOKEN are dropped before matching, so IGNORED_TOKEN should not be
+ * in the sequence. The message which doesn't fit in the buffer is dropped.
+ *
+ * Binary mode: if "BINARY" is set, no bytes are dropped, messages may contain NUL
+ * and end by "END_SEQ" or by END_TOKEN if there is no sequence. The lengths are
+ * needed for binary messages: use the packed mode or "lens" of the queue.
+ *
+ * Idle gap: if "timestamp" and "IDLE_GAP" (ticks) are set, "fifotxt_poll_idle"
+ * queues the partial message after the silence, e.g. the prompt "> ".
+ * It changes the receive buffer like the push functions, so it should run in
+ * the same context as the pushes (e.g. the RX ISR or a timer ISR of the same
+ * priority) or with the RX interrupt masked.
  */
 typedef struct __fifotxt_handle {
     const uint8_t END_TOKEN;
     const uint8_t IGNORED_TOKEN;
+    const bool PACKED;
+
+    const uint8_t * const END_SEQ;
+    const uint8_t END_SEQ_LEN;
+    const bool BINARY;
+
+    const __fifotxt_overflow_policy OVERFLOW_POLICY;
+
+    const __qstat_timestamp timestamp;
+    const uint32_t IDLE_GAP;
 
     __fifotxt_queue * const fqueue;
     __fifotxt_buffer * const fbuf;
 
+    const __fifotxt_matcher * const matcher;
+    void (* const on_match)(struct __fifotxt_handle * const fh, const uint8_t id, const uint8_t * const msg, const uint16_t len);
+
 } __fifotxt_handle;
 
 
@@ -83,6 +220,52 @@ void create_fifotxt(__fifotxt_handle * const fh);
 uint16_t fifotxt_pop_msg(__fifotxt_handle * const fh, uint8_t * in);
 
 
+/**
+ * @brief Get the message without copying. The message is terminated by 0 and
+ *        valid until it is popped or discarded (FIFOTXT_DROP_OLDEST discards too).
+ *        The slot mode without "lens" counts the length of message here.
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @param n - number of message, 0 - the first
+ * @param len - length of message
+ * @return pointer on message or NULL if there are less than n + 1 messages
+ */
+const uint8_t *fifotxt_peek_msg(__fifotxt_handle * const fh, const uint16_t n, uint16_t * const len);
+
+
+/**
+ * @brief Get the pattern id of message
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @param n - number of message, 0 - the first
+ * @return id of the longest pattern which is a prefix of message, FIFOTXT_NO_MATCH
+ *         if there is no such pattern, message or matcher
+ */
+uint8_t fifotxt_msg_tag(__fifotxt_handle * const fh, const uint16_t n);
+
+
+/**
+ * @brief Build the trie of patterns. Call it once before the matcher is used.
+ *
+ * @param matcher - pointer on "__fifotxt_matcher"
+ * @param patterns - table of patterns, the id of pattern is its index + 1
+ * @param cnt - count of patterns
+ * @return false if there are not enough nodes or a pattern is empty
+ */
+bool fifotxt_matcher_compile(__fifotxt_matcher * const matcher, const char * const * patterns, const uint8_t cnt);
+
+
+/**
+ * @brief Match the message by one pass
+ *
+ * @param matcher - pointer on the compiled matcher
+ * @param msg - message
+ * @param len - length of message
+ * @return id of the longest pattern which is a prefix of message or FIFOTXT_NO_MATCH
+ */
+uint8_t fifotxt_match(const __fifotxt_matcher * const matcher, const uint8_t * const msg, const uint16_t len);
+
+
 /**
  *
  */
@@ -119,12 +302,36 @@ void fifotxt_flush_fifo(__fifotxt_handle * const fh);
 bool fifotxt_push_byte(__fifotxt_handle * const fh, const uint8_t byte);
 
 
+/**
+ * @brief Push a received chunk (e.g. DMA buffer), the same as "fifotxt_push_byte"
+ *        for every byte. Runs of plain bytes are found word-at-a-time and
+ *        copied into the buffer at once.
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @param src - chunk
+ * @param len - length of chunk
+ * @return count of completed messages
+ */
+uint16_t fifotxt_push_bytes(__fifotxt_handle * const fh, const uint8_t * const src, const uint16_t len);
+
+
 /**
  *
  */
 void fifotxt_push_msg(__fifotxt_handle * const fh);
 
 
+/**
+ * @brief Queue the partial message if nothing is received during IDLE_GAP.
+ *        Not safe against a concurrent push: call it from the main loop with
+ *        the RX interrupt masked, or from the context of the pushes.
+ *
+ * @param fh - pointer on "__fifotxt_handle"
+ * @return true if the partial message is flushed
+ */
+bool fifotxt_poll_idle(__fifotxt_handle * const fh);
+
+
 /**
  *
  */
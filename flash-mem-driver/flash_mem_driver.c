@@ -22,10 +22,20 @@
 #define FMDR_CHECK_CHIP_BUSY(s)      ((s)&0x01)
 #define FMDR_CHECK_CHIP_WEL(s)       ((s)&0x02)
 
+#define FMDR_IS_ASYNC_BUSY()         (handle->async && handle->async->state != FMDR_ASYNC_IDLE)
+
 
 
 static __flash_mem_op_status write_enable(const __flash_mem_handle * const handle);
 static __flash_mem_op_status flash_mem_read_sreg(const __flash_mem_handle * const handle, uint8_t * sreg);
+static __flash_mem_op_status prepare_write(const __flash_mem_handle * const handle);
+static __flash_mem_op_status program_page(const __flash_mem_handle * const handle, __flash_mem_data *wdata);
+static __flash_mem_op_status erase(const __flash_mem_handle * const handle, const uint8_t opcode, const __flash_mem_address * const faddr);
+static __flash_mem_op_status wait_ready(const __flash_mem_handle * const handle, const uint32_t delay);
+static __flash_mem_op_status erase_start(const __flash_mem_handle * const handle, const uint8_t opcode,
+        const __flash_mem_address * const faddr, const __flash_mem_async_cb callback);
+static __flash_mem_op_status async_issued(const __flash_mem_handle * const handle, const __flash_mem_op_status status,
+        const __flash_mem_async_cb callback);
 
 
 __flash_mem_op_status
@@ -34,6 +44,10 @@ flash_mem_read_info(const __flash_mem_handle * const handle, __flash_mem_info *i
     uint8_t opcode = FMDR_GET_OPCODE(READ_CHIP_ID);
     uint32_t err = 0;
     
+    if (FMDR_IS_ASYNC_BUSY()) {
+        return FMDR_BUSY_ERROR;
+    }
+    
     FMDR_SELECT_CHIP();
     
     err = FMDR_WRITE_DATA(&opcode, 1);
@@ -63,6 +77,11 @@ flash_mem_read_data(const __flash_mem_handle * const handle, __flash_mem_data *r
         return FMDR_ADDR_ERROR;
     }
     
+    /* the chip doesn't return data while it is programming */
+    if (FMDR_IS_ASYNC_BUSY()) {
+        return FMDR_BUSY_ERROR;
+    }
+    
     wbuf[0] = FMDR_GET_OPCODE(READ_DATA);
     wbuf[1] = rdata->faddr.addr[2];
     wbuf[2] = rdata->faddr.addr[1];
@@ -92,234 +111,197 @@ __flash_mem_op_status
 flash_mem_write_page_data(const __flash_mem_handle * const handle, __flash_mem_data *wdata)
 {
     uint32_t err = 0;
-    uint8_t sreg;
     
-    if (wdata->faddr.addr32 >= handle->descriptor->FLASH_MEM_VOLUME) {
-        return FMDR_ADDR_ERROR;
+    err = program_page(handle, wdata);
+    
+    if (err) {
+        return err;
     }
     
-    const uint32_t page_size = handle->descriptor->PAGE_SIZE;
-    const uint32_t free_size = page_size - (wdata->faddr.addr32 % page_size);
+    return wait_ready(handle, handle->descriptor->PAGE_WRITE_TIMEOUT_US);
+}
+
+
+
+__flash_mem_op_status
+flash_mem_sector_erase(const __flash_mem_handle * const handle, const __flash_mem_address faddr)
+{
+    uint32_t err = 0;
     
-    if (wdata->len > free_size) {
+    if (faddr.addr32 > handle->descriptor->FLASH_MEM_VOLUME - 1) {
         return FMDR_DATA_ERROR;
     }
     
-    /* check BUSY/WRE */
-    err = flash_mem_read_sreg(handle, &sreg);
+    if (FMDR_IS_ASYNC_BUSY()) {
+        return FMDR_BUSY_ERROR;
+    }
+    
+    err = erase(handle, FMDR_GET_OPCODE(SECTOR_ERASE), &faddr);
+    
     if (err) {
         return err;
-    } else {
-        /* check on busy */
-        if (FMDR_CHECK_CHIP_BUSY(sreg)) {
-            return FMDR_BUSY_ERROR;
-        } else if (!FMDR_CHECK_CHIP_WEL(sreg)) {
-            err = write_enable(handle);
-            if (err != FMDR_OK) {
-                return err;
-            }
-        }
     }
     
-    /* fast write support */
-    if (handle->descriptor->FAST_WRITE_EN) {
-        
-        wdata->buf[0] = FMDR_GET_OPCODE(PAGE_PROGRAM);
-        wdata->buf[1] = wdata->faddr.addr[2];
-        wdata->buf[2] = wdata->faddr.addr[1];
-        wdata->buf[3] = wdata->faddr.addr[0];
-        
-        FMDR_SELECT_CHIP();
-        
-    } else {
-        uint8_t wbuf[4];
-        
-        wbuf[0] = FMDR_GET_OPCODE(PAGE_PROGRAM);
-        wbuf[1] = wdata->faddr.addr[2];
-        wbuf[2] = wdata->faddr.addr[1];
-        wbuf[3] = wdata->faddr.addr[0];
-        
-        FMDR_SELECT_CHIP();
-        
-        err = FMDR_WRITE_DATA(wbuf, 4);
-        
-        if (err || FMDR_IS_SPI_BUSY()) {
-            FMDR_RETURN_ERROR(FMDR_ERROR);
-        }
-    }
+    return wait_ready(handle, handle->descriptor->SECTOR_ERASE_TIMEOUT_MS * 1000);
+}
+
+
+__flash_mem_op_status
+flash_mem_block32_erase(const __flash_mem_handle * const handle, const __flash_mem_address faddr)
+{
+    uint32_t err = 0;
     
-    err = FMDR_WRITE_DATA(wdata->buf, wdata->len + (handle->descriptor->FAST_WRITE_EN ? 4 : 0));
+    if (faddr.addr32 > handle->descriptor->FLASH_MEM_VOLUME - 1) {
+        return FMDR_DATA_ERROR;
+    }
     
-    if (err || FMDR_IS_SPI_BUSY()) {
-        FMDR_RETURN_ERROR(FMDR_ERROR);
+    if (FMDR_IS_ASYNC_BUSY()) {
+        return FMDR_BUSY_ERROR;
     }
     
-    FMDR_DESELECT_CHIP();
+    err = erase(handle, FMDR_GET_OPCODE(BLOCK32_ERASE), &faddr);
     
-    /* check on busy */
-    while(1) {
-        err = flash_mem_read_sreg(handle, &sreg);
-        
-        if (err) {
-            return err;
-        }
-        
-        if (FMDR_CHECK_CHIP_BUSY(sreg)) {
-            err = FMDR_DELAY(handle->descriptor->PAGE_WRITE_TIMEOUT_US);
-            
-            if (err) {
-                return err;
-            }
-        } else {
-            break;
-        }
+    if (err) {
+        return err;
     }
     
-    return FMDR_OK;
+    return wait_ready(handle, handle->descriptor->BLOCK32_ERASE_TIMEOUT_MS * 1000);
 }
 
 
-
 __flash_mem_op_status
-flash_mem_sector_erase(const __flash_mem_handle * const handle, const __flash_mem_address faddr)
+flash_mem_block64_erase(const __flash_mem_handle * const handle, const __flash_mem_address faddr)
 {
     uint32_t err = 0;
-    uint8_t sreg;
-    uint8_t wbuf[4];
     
     if (faddr.addr32 > handle->descriptor->FLASH_MEM_VOLUME - 1) {
         return FMDR_DATA_ERROR;
     }
     
-    /* check BUSY/WRE */
-    err = flash_mem_read_sreg(handle, &sreg);
+    if (FMDR_IS_ASYNC_BUSY()) {
+        return FMDR_BUSY_ERROR;
+    }
+    
+    err = erase(handle, FMDR_GET_OPCODE(BLOCK64_ERASE), &faddr);
+    
     if (err) {
         return err;
-    } else {
-        /* check on busy */
-        if (FMDR_CHECK_CHIP_BUSY(sreg)) {
-            return FMDR_BUSY_ERROR;
-        } else if (!FMDR_CHECK_CHIP_WEL(sreg)) {
-            err = write_enable(handle);
-            if (err != FMDR_OK) {
-                return err;
-            }
-        }
     }
     
-    wbuf[0] = FMDR_GET_OPCODE(SECTOR_ERASE);
-    wbuf[1] = faddr.addr[2];
-    wbuf[2] = faddr.addr[1];
-    wbuf[3] = faddr.addr[0];
+    return wait_ready(handle, handle->descriptor->BLOCK64_ERASE_TIMEOUT_MS * 1000);
+}
+
+
+__flash_mem_op_status
+flash_mem_chip_erase(const __flash_mem_handle * const handle)
+{
+    uint32_t err = 0;
     
-    FMDR_SELECT_CHIP();
+    if (FMDR_IS_ASYNC_BUSY()) {
+        return FMDR_BUSY_ERROR;
+    }
     
-    err = FMDR_WRITE_DATA(wbuf, 4);
+    err = erase(handle, FMDR_GET_OPCODE(CHIP_ERASE), NULL);
     
-    if (err || FMDR_IS_SPI_BUSY()) {
-        FMDR_RETURN_ERROR(FMDR_ERROR);
+    if (err) {
+        return err;
     }
     
-    FMDR_DESELECT_CHIP();
-    
-    /* check on busy */
-    while(1) {
-        err = flash_mem_read_sreg(handle, &sreg);
-        
-        if (err) {
-            return err;
-        }
-        
-        if (FMDR_CHECK_CHIP_BUSY(sreg)) {
-            err = FMDR_DELAY(handle->descriptor->SECTOR_ERASE_TIMEOUT_MS * 1000);
-            
-            if (err) {
-                return err;
-            }
-        } else {
-            break;
-        }
+    return wait_ready(handle, handle->descriptor->CHIP_ERASE_TIMEOUT_MS * 1000);
+}
+
+
+__flash_mem_op_status
+flash_mem_write_page_data_start(const __flash_mem_handle * const handle, __flash_mem_data *wdata,
+        const __flash_mem_async_cb callback)
+{
+    if (!handle->async) {
+        return FMDR_ERROR;
     }
     
-    return FMDR_OK;
+    return async_issued(handle, program_page(handle, wdata), callback);
 }
 
 
 __flash_mem_op_status
-flash_mem_block32_erase(const __flash_mem_handle * const handle, const __flash_mem_address faddr)
+flash_mem_sector_erase_start(const __flash_mem_handle * const handle, const __flash_mem_address faddr,
+        const __flash_mem_async_cb callback)
+{
+    return erase_start(handle, FMDR_GET_OPCODE(SECTOR_ERASE), &faddr, callback);
+}
+
+
+__flash_mem_op_status
+flash_mem_block32_erase_start(const __flash_mem_handle * const handle, const __flash_mem_address faddr,
+        const __flash_mem_async_cb callback)
+{
+    return erase_start(handle, FMDR_GET_OPCODE(BLOCK32_ERASE), &faddr, callback);
+}
+
+
+__flash_mem_op_status
+flash_mem_block64_erase_start(const __flash_mem_handle * const handle, const __flash_mem_address faddr,
+        const __flash_mem_async_cb callback)
+{
+    return erase_start(handle, FMDR_GET_OPCODE(BLOCK64_ERASE), &faddr, callback);
+}
+
+
+__flash_mem_op_status
+flash_mem_chip_erase_start(const __flash_mem_handle * const handle, const __flash_mem_async_cb callback)
 {
+    return erase_start(handle, FMDR_GET_OPCODE(CHIP_ERASE), NULL, callback);
+}
+
+
+__flash_mem_op_status
+flash_mem_poll(const __flash_mem_handle * const handle)
+{
+    __flash_mem_async * const async = handle->async;
+    __flash_mem_async_cb callback;
     uint32_t err = 0;
     uint8_t sreg;
-    uint8_t wbuf[4];
     
-    if (faddr.addr32 > handle->descriptor->FLASH_MEM_VOLUME - 1) {
-        return FMDR_DATA_ERROR;
+    if (!FMDR_IS_ASYNC_BUSY()) {
+        return FMDR_OK;
     }
     
-    /* check BUSY/WRE */
+    /* one short transaction per call, the chip works meanwhile */
     err = flash_mem_read_sreg(handle, &sreg);
+    
+    /* the chip may be still busy, the operation stays in progress */
     if (err) {
         return err;
-    } else {
-        /* check on busy */
-        if (FMDR_CHECK_CHIP_BUSY(sreg)) {
-            return FMDR_BUSY_ERROR;
-        } else if (!FMDR_CHECK_CHIP_WEL(sreg)) {
-            err = write_enable(handle);
-            if (err != FMDR_OK) {
-                return err;
-            }
-        }
     }
     
-    wbuf[0] = FMDR_GET_OPCODE(BLOCK32_ERASE);
-    wbuf[1] = faddr.addr[2];
-    wbuf[2] = faddr.addr[1];
-    wbuf[3] = faddr.addr[0];
-    
-    FMDR_SELECT_CHIP();
-    
-    err = FMDR_WRITE_DATA(wbuf, 4);
-    
-    if (err || FMDR_IS_SPI_BUSY()) {
-        FMDR_RETURN_ERROR(FMDR_ERROR);
+    if (FMDR_CHECK_CHIP_BUSY(sreg)) {
+        return FMDR_IN_PROGRESS;
     }
     
-    FMDR_DESELECT_CHIP();
+    callback = async->callback;
     
-    /* check on busy */
-    while(1) {
-        err = flash_mem_read_sreg(handle, &sreg);
-        
-        if (err) {
-            return err;
-        }
-        
-        if (FMDR_CHECK_CHIP_BUSY(sreg)) {
-            err = FMDR_DELAY(handle->descriptor->BLOCK32_ERASE_TIMEOUT_MS * 1000);
-            
-            if (err) {
-                return err;
-            }
-        } else {
-            break;
-        }
+    async->state = FMDR_ASYNC_IDLE;
+    async->callback = NULL;
+    
+    /* the callback may start the next operation */
+    if (callback) {
+        callback(handle, FMDR_OK);
     }
     
     return FMDR_OK;
 }
 
 
-__flash_mem_op_status
-flash_mem_block64_erase(const __flash_mem_handle * const handle, const __flash_mem_address faddr)
+/**
+ * @brief Check the chip is not busy and set the write enable latch.
+ *
+ * @param handle - pointer on management structure with low level API
+ * @return status operation
+ */
+static __flash_mem_op_status prepare_write(const __flash_mem_handle * const handle)
 {
     uint32_t err = 0;
     uint8_t sreg;
-    uint8_t wbuf[4];
-    
-    if (faddr.addr32 > handle->descriptor->FLASH_MEM_VOLUME - 1) {
-        return FMDR_DATA_ERROR;
-    }
     
     /* check BUSY/WRE */
     err = flash_mem_read_sreg(handle, &sreg);
@@ -337,70 +319,113 @@ flash_mem_block64_erase(const __flash_mem_handle * const handle, const __flash_m
         }
     }
     
-    wbuf[0] = FMDR_GET_OPCODE(BLOCK64_ERASE);
-    wbuf[1] = faddr.addr[2];
-    wbuf[2] = faddr.addr[1];
-    wbuf[3] = faddr.addr[0];
+    return FMDR_OK;
+}
+
+
+/**
+ * @brief Check the page and issue the program command, don't wait for the end of writing.
+ *
+ * @param handle - pointer on management structure with low level API
+ * @param wdata - pointer on "__flash_mem_data"
+ * @return status operation
+ */
+static __flash_mem_op_status
+program_page(const __flash_mem_handle * const handle, __flash_mem_data *wdata)
+{
+    uint32_t err = 0;
+    
+    if (wdata->faddr.addr32 >= handle->descriptor->FLASH_MEM_VOLUME) {
+        return FMDR_ADDR_ERROR;
+    }
     
-    FMDR_SELECT_CHIP();
+    const uint32_t page_size = handle->descriptor->PAGE_SIZE;
+    const uint32_t free_size = page_size - (wdata->faddr.addr32 % page_size);
     
-    err = FMDR_WRITE_DATA(wbuf, 4);
+    if (wdata->len > free_size) {
+        return FMDR_DATA_ERROR;
+    }
     
-    if (err || FMDR_IS_SPI_BUSY()) {
-        FMDR_RETURN_ERROR(FMDR_ERROR);
+    if (FMDR_IS_ASYNC_BUSY()) {
+        return FMDR_BUSY_ERROR;
     }
     
-    FMDR_DESELECT_CHIP();
+    err = prepare_write(handle);
     
-    /* check on busy */
-    while(1) {
-        err = flash_mem_read_sreg(handle, &sreg);
+    if (err) {
+        return err;
+    }
+    
+    /* fast write support */
+    if (handle->descriptor->FAST_WRITE_EN) {
         
-        if (err) {
-            return err;
-        }
+        wdata->buf[0] = FMDR_GET_OPCODE(PAGE_PROGRAM);
+        wdata->buf[1] = wdata->faddr.addr[2];
+        wdata->buf[2] = wdata->faddr.addr[1];
+        wdata->buf[3] = wdata->faddr.addr[0];
         
-        if (FMDR_CHECK_CHIP_BUSY(sreg)) {
-            err = FMDR_DELAY(handle->descriptor->BLOCK64_ERASE_TIMEOUT_MS * 1000);
-            
-            if (err) {
-                return err;
-            }
-        } else {
-            break;
+        FMDR_SELECT_CHIP();
+        
+    } else {
+        uint8_t wbuf[4];
+        
+        wbuf[0] = FMDR_GET_OPCODE(PAGE_PROGRAM);
+        wbuf[1] = wdata->faddr.addr[2];
+        wbuf[2] = wdata->faddr.addr[1];
+        wbuf[3] = wdata->faddr.addr[0];
+        
+        FMDR_SELECT_CHIP();
+        
+        err = FMDR_WRITE_DATA(wbuf, 4);
+        
+        if (err || FMDR_IS_SPI_BUSY()) {
+            FMDR_RETURN_ERROR(FMDR_ERROR);
         }
     }
     
+    err = FMDR_WRITE_DATA(wdata->buf, wdata->len + (handle->descriptor->FAST_WRITE_EN ? 4 : 0));
+    
+    if (err || FMDR_IS_SPI_BUSY()) {
+        FMDR_RETURN_ERROR(FMDR_ERROR);
+    }
+    
+    FMDR_DESELECT_CHIP();
+    
     return FMDR_OK;
 }
 
 
-__flash_mem_op_status
-flash_mem_chip_erase(const __flash_mem_handle * const handle)
+/**
+ * @brief Issue the erase command, don't wait for the end of erasing.
+ *
+ * @param handle - pointer on management structure with low level API
+ * @param opcode - erase opcode
+ * @param faddr - address inside of the erased area, NULL for the chip erase
+ * @return status operation
+ */
+static __flash_mem_op_status
+erase(const __flash_mem_handle * const handle, const uint8_t opcode, const __flash_mem_address * const faddr)
 {
-    uint8_t opcode = FMDR_GET_OPCODE(CHIP_ERASE);
     uint32_t err = 0;
-    uint8_t sreg;
+    uint8_t wbuf[4];
+    
+    err = prepare_write(handle);
     
-    /* check BUSY/WRE */
-    err = flash_mem_read_sreg(handle, &sreg);
     if (err) {
         return err;
-    } else {
-        /* check on busy */
-        if (FMDR_CHECK_CHIP_BUSY(sreg)) {
-            return FMDR_BUSY_ERROR;
-        } else if (!FMDR_CHECK_CHIP_WEL(sreg)) {
-            err = write_enable(handle);
-            if (err != FMDR_OK) {
-                return err;
-            }
-        }
+    }
+    
+    wbuf[0] = opcode;
+    
+    if (faddr) {
+        wbuf[1] = faddr->addr[2];
+        wbuf[2] = faddr->addr[1];
+        wbuf[3] = faddr->addr[0];
     }
     
     FMDR_SELECT_CHIP();
     
-    err = FMDR_WRITE_DATA(&opcode, 1);
+    err = FMDR_WRITE_DATA(wbuf, faddr ? 4 : 1);
     
     if (err || FMDR_IS_SPI_BUSY()) {
         FMDR_RETURN_ERROR(FMDR_ERROR);
@@ -408,6 +433,22 @@ flash_mem_chip_erase(const __flash_mem_handle * const handle)
     
     FMDR_DESELECT_CHIP();
     
+    return FMDR_OK;
+}
+
+
+/**
+ * @brief Wait while the chip is busy.
+ *
+ * @param handle - pointer on management structure with low level API
+ * @param delay - delay between checks, usec
+ * @return status operation
+ */
+static __flash_mem_op_status wait_ready(const __flash_mem_handle * const handle, const uint32_t delay)
+{
+    uint32_t err = 0;
+    uint8_t sreg;
+    
     /* check on busy */
     while(1) {
         err = flash_mem_read_sreg(handle, &sreg);
@@ -417,7 +458,7 @@ flash_mem_chip_erase(const __flash_mem_handle * const handle)
         }
         
         if (FMDR_CHECK_CHIP_BUSY(sreg)) {
-            err = FMDR_DELAY(handle->descriptor->CHIP_ERASE_TIMEOUT_MS * 1000);
+            err = FMDR_DELAY(delay);
             
             if (err) {
                 return err;
@@ -431,6 +472,56 @@ flash_mem_chip_erase(const __flash_mem_handle * const handle)
 }
 
 
+/**
+ * @brief Start the async erase.
+ *
+ * @param handle - pointer on management structure with low level API
+ * @param opcode - erase opcode
+ * @param faddr - address inside of the erased area, NULL for the chip erase
+ * @param callback - completion callback
+ * @return status operation
+ */
+static __flash_mem_op_status
+erase_start(const __flash_mem_handle * const handle, const uint8_t opcode,
+        const __flash_mem_address * const faddr, const __flash_mem_async_cb callback)
+{
+    if (!handle->async) {
+        return FMDR_ERROR;
+    }
+    
+    if (faddr && faddr->addr32 > handle->descriptor->FLASH_MEM_VOLUME - 1) {
+        return FMDR_DATA_ERROR;
+    }
+    
+    if (FMDR_IS_ASYNC_BUSY()) {
+        return FMDR_BUSY_ERROR;
+    }
+    
+    return async_issued(handle, erase(handle, opcode, faddr), callback);
+}
+
+
+/**
+ * @brief Switch the state machine to waiting if the command is issued.
+ *
+ * @param handle - pointer on management structure with low level API
+ * @param status - status of the issued command
+ * @param callback - completion callback
+ * @return status
+ */
+static __flash_mem_op_status
+async_issued(const __flash_mem_handle * const handle, const __flash_mem_op_status status,
+        const __flash_mem_async_cb callback)
+{
+    if (status == FMDR_OK) {
+        handle->async->callback = callback;
+        handle->async->state = FMDR_ASYNC_WAIT_READY;
+    }
+    
+    return status;
+}
+
+
 /**
  * @brief Read the status register
  *        Byte1:
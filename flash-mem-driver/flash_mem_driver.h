@@ -16,6 +16,11 @@
  *
  * 5) Use public API functions with this handle.
  *
+ * Async mode: add "__flash_mem_async" to the handle. The "*_start" functions
+ * return right after the command is issued, "flash_mem_poll" is called from
+ * the main loop (or a timer) and fires the callback when the chip is ready.
+ * Only one operation is in progress per handle.
+ *
  */
 
 
@@ -27,15 +32,39 @@
 #include <stdint.h>
 
 
+#ifndef NULL
+#define NULL ((void *)0)
+#endif
+
+
 typedef enum {
     FMDR_OK = 0,
     FMDR_ERROR,
     FMDR_ADDR_ERROR,
     FMDR_DATA_ERROR,
-    FMDR_BUSY_ERROR
+    FMDR_BUSY_ERROR,
+    FMDR_IN_PROGRESS
 } __flash_mem_op_status;
 
 
+typedef enum {
+    FMDR_ASYNC_IDLE = 0,
+    FMDR_ASYNC_WAIT_READY
+} __flash_mem_async_state;
+
+
+struct __flash_mem_handle;
+
+
+/**
+ * @brief Completion callback of async operation.
+ *
+ * @param handle - handle of the finished operation
+ * @param status - FMDR_OK, the chip is ready
+ */
+typedef void (* __flash_mem_async_cb)(const struct __flash_mem_handle * const handle, const __flash_mem_op_status status);
+
+
 /**
  * @brief Union that determines a address in the flash mem.
  *
@@ -138,14 +167,30 @@ typedef struct {
 
 
 /**
- * Management structure
+ * @brief State of async operation.
+ *
+ * @field state - FMDR_ASYNC_IDLE or the operation is in progress
+ * @field callback - completion callback of the current operation, may be NULL
  */
 typedef struct {
+    __flash_mem_async_state state;
+    __flash_mem_async_cb callback;
+} __flash_mem_async;
+
+
+/**
+ * Management structure
+ *
+ * @field async - state of async mode, NULL if it isn't used
+ */
+typedef struct __flash_mem_handle {
     
     const __flash_mem_descriptor * const descriptor;
     const __flash_mem_opcodes * const opcodes;
     const __flash_mem_api * const api;
     
+    __flash_mem_async * const async;
+    
 } __flash_mem_handle;
 
 
@@ -227,4 +272,80 @@ __flash_mem_op_status flash_mem_block64_erase(const __flash_mem_handle * const h
 __flash_mem_op_status flash_mem_chip_erase(const __flash_mem_handle * const handle);
 
 
+/**
+ * @brief Public API.
+ *        Start writing a data in the flash mem, don't wait for the end of writing.
+ *
+ * @param handle - pointer on management structure with async state
+ * @param wdata - pointer on "__flash_mem_data"
+ * @param callback - completion callback, may be NULL
+ * @return status operation, FMDR_BUSY_ERROR if the previous operation is in progress
+ */
+__flash_mem_op_status flash_mem_write_page_data_start(const __flash_mem_handle * const handle, __flash_mem_data *wdata,
+        const __flash_mem_async_cb callback);
+
+
+/**
+ * @brief Public API.
+ *        Start erasing sector.
+ *
+ * @param handle - pointer on management structure with async state
+ * @param faddr - any address inside of selected sector
+ * @param callback - completion callback, may be NULL
+ * @return status operation
+ */
+__flash_mem_op_status flash_mem_sector_erase_start(const __flash_mem_handle * const handle, const __flash_mem_address faddr,
+        const __flash_mem_async_cb callback);
+
+
+/**
+ * @brief Public API.
+ *        Start erasing block32k.
+ *
+ * @param handle - pointer on management structure with async state
+ * @param faddr - any address inside of selected block
+ * @param callback - completion callback, may be NULL
+ * @return status operation
+ */
+__flash_mem_op_status flash_mem_block32_erase_start(const __flash_mem_handle * const handle, const __flash_mem_address faddr,
+        const __flash_mem_async_cb callback);
+
+
+/**
+ * @brief Public API.
+ *        Start erasing block64k.
+ *
+ * @param handle - pointer on management structure with async state
+ * @param faddr - any address inside of selected block
+ * @param callback - completion callback, may be NULL
+ * @return status operation
+ */
+__flash_mem_op_status flash_mem_block64_erase_start(const __flash_mem_handle * const handle, const __flash_mem_address faddr,
+        const __flash_mem_async_cb callback);
+
+
+/**
+ * @brief Public API.
+ *        Start erasing chip.
+ *
+ * @param handle - pointer on management structure with async state
+ * @param callback - completion callback, may be NULL
+ * @return status operation
+ */
+__flash_mem_op_status flash_mem_chip_erase_start(const __flash_mem_handle * const handle, const __flash_mem_async_cb callback);
+
+
+/**
+ * @brief Public API.
+ *        Check the async operation by one read of the status register, don't wait.
+ *        The callback is fired when the chip is ready.
+ *
+ * @param handle - pointer on management structure with async state
+ * @return FMDR_IN_PROGRESS while the chip is busy, FMDR_OK if there is no operation
+ *         or it is finished, FMDR_ERROR if the status register can't be read
+ *         (the operation stays in progress, poll it again)
+ */
+__flash_mem_op_status flash_mem_poll(const __flash_mem_handle * const handle);
+
+
 #endif /* __FLASH_MEM_DRIVER_H */
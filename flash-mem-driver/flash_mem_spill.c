@@ -0,0 +1,377 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ */
+
+
+#include "flash_mem_spill.h"
+
+#include <shared_utils.h>
+#include <crc8.h>
+
+
+/**
+ * Private useful macros
+ *
+ */
+#define  FSP_PAGE_SIZE(sp)                ((sp)->fml->descriptor->fmh->descriptor->PAGE_SIZE)
+#define  FSP_SECTOR_SIZE(sp)              ((sp)->fml->descriptor->fmh->descriptor->SECTOR_SIZE)
+#define  FSP_MEM_SIZE(sp)                 ((sp)->fml->descriptor->MEM_VOLUME)
+#define  FSP_PREFIX(sp)                   ((sp)->fml->descriptor->fmh->descriptor->FAST_WRITE_EN ? FMEM_SPILL_PREFIX_SIZE : 0)
+#define  FSP_PAYLOAD_SIZE(sp)             (FSP_PAGE_SIZE(sp) - FMEM_SPILL_HEADER_SIZE)
+
+#define  FSP_IS_NEW_SECTOR(sp,a)          (((a) % FSP_SECTOR_SIZE(sp)) ? 0 : 1)
+#define  FSP_SECTOR_START(sp,a)           ((a) - ((a) % FSP_SECTOR_SIZE(sp)))
+
+/* header: seq (4), len (2), crc8 (1), state (1) */
+#define  FSP_HDR_SEQ                      0
+#define  FSP_HDR_LEN                      4
+#define  FSP_HDR_CRC                      6
+#define  FSP_HDR_STATE                    7
+
+/* state of batch, every next state only clears bits */
+#define  FSP_STATE_FREE                   0xFF
+#define  FSP_STATE_DATA                   0xA5
+#define  FSP_STATE_DONE                   0x05
+#define  FSP_STATE_DRAINED                0x00      /* the first batch of sector only */
+
+
+typedef struct {
+    uint32_t seq;
+    uint16_t len;
+    uint8_t crc;
+    uint8_t state;
+} __fsp_header;
+
+
+static __flash_mem_layer_status read_header(__fmem_spill * const sp, const uint32_t addr, __fsp_header * const header);
+static __flash_mem_layer_status set_state(__fmem_spill * const sp, const uint32_t addr, const uint8_t state);
+static uint32_t next_page(__fmem_spill * const sp, const uint32_t addr);
+static __flash_mem_layer_status advance_read(__fmem_spill * const sp);
+
+
+
+/**
+ *
+ */
+__fmem_spill_status fmem_spill_init(__fmem_spill * const sp)
+{
+    __fsp_header header;
+    uint32_t addr;
+    uint32_t head;
+    uint32_t tail;
+    uint32_t head_seq;
+    uint32_t tail_seq;
+    bool found;
+    bool live;
+
+    sp->wr_addr = sp->rd_addr = 0;
+    sp->seq = 0;
+    sp->crc_errors = 0;
+    sp->flash_errors = 0;
+
+    head = tail = 0;
+    head_seq = tail_seq = 0;
+    found = live = false;
+
+    /* scan sector headers: the newest sector is the tail, the oldest not drained is the head */
+    for (addr = 0; addr < FSP_MEM_SIZE(sp); addr += FSP_SECTOR_SIZE(sp)) {
+        if (read_header(sp, addr, &header) != FML_OK) {
+            return FMEM_SPILL_FLASH_ERROR;
+        }
+
+        if (header.state == FSP_STATE_FREE) {
+            continue;
+        }
+
+        if (!found || header.seq > tail_seq) {
+            tail_seq = header.seq;
+            tail = addr;
+            found = true;
+        }
+
+        if (header.state != FSP_STATE_DRAINED && (!live || header.seq < head_seq)) {
+            head_seq = header.seq;
+            head = addr;
+            live = true;
+        }
+    }
+
+    if (!found) {
+        return FMEM_SPILL_OK;
+    }
+
+    /* the first free page of the tail sector */
+    sp->wr_addr = tail;
+
+    do {
+        if (read_header(sp, sp->wr_addr, &header) != FML_OK) {
+            return FMEM_SPILL_FLASH_ERROR;
+        }
+
+        if (header.state == FSP_STATE_FREE) {
+            break;
+        }
+
+        sp->seq = header.seq + 1;
+        sp->wr_addr = next_page(sp, sp->wr_addr);
+
+    } while (!FSP_IS_NEW_SECTOR(sp, sp->wr_addr));
+
+    /* the first not consumed batch from the head sector, the writer may be at its start */
+    sp->rd_addr = live ? head : sp->wr_addr;
+
+    if (!live) {
+        return FMEM_SPILL_OK;
+    }
+
+    do {
+        if (read_header(sp, sp->rd_addr, &header) != FML_OK) {
+            return FMEM_SPILL_FLASH_ERROR;
+        }
+
+        if (header.state == FSP_STATE_DATA) {
+            break;
+        }
+
+        if (advance_read(sp) != FML_OK) {
+            sp->flash_errors++;
+            return FMEM_SPILL_FLASH_ERROR;
+        }
+
+    } while (sp->rd_addr != sp->wr_addr);
+
+    return FMEM_SPILL_OK;
+}
+
+
+/**
+ *
+ */
+bool fmem_spill_push(__fmem_spill * const sp, const uint8_t * const src, const uint16_t len)
+{
+    return smfifo_push_data(sp->fifo, src, len);
+}
+
+
+/**
+ *
+ */
+__fmem_spill_status fmem_spill_process(__fmem_spill * const sp)
+{
+    __fmem_layer_data wdata;
+    uint8_t * const batch = sp->page + FSP_PREFIX(sp);
+    uint16_t filled;
+    uint16_t len;
+
+    filled = smfifo_filled_space(sp->fifo);
+
+    if (filled <= sp->threshold) {
+        return FMEM_SPILL_OK;
+    }
+
+    /* the writer erases the next sector, it should not hold the head */
+    if (FSP_IS_NEW_SECTOR(sp, sp->wr_addr) && sp->rd_addr != sp->wr_addr
+            && FSP_SECTOR_START(sp, sp->rd_addr) == sp->wr_addr) {
+        return FMEM_SPILL_FULL;
+    }
+
+    /* the equal addresses are the empty queue, so one page is kept free */
+    if (next_page(sp, sp->wr_addr) == sp->rd_addr) {
+        return FMEM_SPILL_FULL;
+    }
+
+    len = filled < FSP_PAYLOAD_SIZE(sp) ? filled : FSP_PAYLOAD_SIZE(sp);
+
+    /* the data leaves RAM only after it is written */
+    smfifo_peek_at(sp->fifo, 0, batch + FMEM_SPILL_HEADER_SIZE, len);
+
+    batch[FSP_HDR_SEQ] = (uint8_t)sp->seq;
+    batch[FSP_HDR_SEQ + 1] = (uint8_t)(sp->seq >> 8);
+    batch[FSP_HDR_SEQ + 2] = (uint8_t)(sp->seq >> 16);
+    batch[FSP_HDR_SEQ + 3] = (uint8_t)(sp->seq >> 24);
+    batch[FSP_HDR_LEN] = (uint8_t)len;
+    batch[FSP_HDR_LEN + 1] = (uint8_t)(len >> 8);
+    batch[FSP_HDR_CRC] = crc8_dallas(batch + FMEM_SPILL_HEADER_SIZE, len);
+    batch[FSP_HDR_STATE] = FSP_STATE_DATA;
+
+    /* a write at the start of sector erases it */
+    wdata.addr = sp->wr_addr;
+    wdata.buf = sp->page;
+    wdata.len = FMEM_SPILL_HEADER_SIZE + len;
+
+    if (fmem_write_data(sp->fml, &wdata) != FML_OK) {
+        return FMEM_SPILL_FLASH_ERROR;
+    }
+
+    smfifo_shift_cursor(sp->fifo, len);
+
+    sp->wr_addr = next_page(sp, sp->wr_addr);
+    sp->seq++;
+
+    return FMEM_SPILL_OK;
+}
+
+
+/**
+ *
+ */
+uint16_t fmem_spill_pop(__fmem_spill * const sp, uint8_t * const dst, const uint16_t len)
+{
+    __fmem_layer_data rdata;
+    __fsp_header header;
+    uint16_t cnt;
+
+    while (sp->rd_addr != sp->wr_addr) {
+        if (read_header(sp, sp->rd_addr, &header) != FML_OK) {
+            return 0;
+        }
+
+        cnt = 0;
+
+        if (header.state == FSP_STATE_DATA) {
+            if (header.len > len) {
+                return 0;
+            }
+
+            rdata.addr = sp->rd_addr + FMEM_SPILL_HEADER_SIZE;
+            rdata.buf = dst;
+            rdata.len = header.len;
+
+            if (header.len > FSP_PAYLOAD_SIZE(sp) || fmem_read_data(sp->fml, &rdata) != FML_OK
+                    || crc8_dallas(dst, header.len) != header.crc) {
+                sp->crc_errors++;
+            } else {
+                cnt = header.len;
+            }
+
+            if (set_state(sp, sp->rd_addr, FSP_STATE_DONE) != FML_OK) {
+                sp->flash_errors++;
+                return 0;
+            }
+        }
+
+        /* the batch is consumed already, the failed mark is retried by the next call */
+        if (advance_read(sp) != FML_OK) {
+            sp->flash_errors++;
+            return cnt;
+        }
+
+        if (cnt) {
+            return cnt;
+        }
+    }
+
+    /* the flash is empty, the rest is in RAM */
+    cnt = smfifo_filled_space(sp->fifo);
+    cnt = len < cnt ? len : cnt;
+
+    if (cnt) {
+        smfifo_pop_data(sp->fifo, dst, cnt);
+    }
+
+    return cnt;
+}
+
+
+/**
+ *
+ */
+bool fmem_spill_is_empty(__fmem_spill * const sp)
+{
+    return sp->rd_addr == sp->wr_addr && !smfifo_filled_space(sp->fifo);
+}
+
+
+/**
+ * @brief Read the batch header
+ *
+ * @param sp - pointer on "__fmem_spill"
+ * @param addr - address of the batch
+ * @param header - parsed header
+ * @return status of the flash layer
+ */
+static __flash_mem_layer_status read_header(__fmem_spill * const sp, const uint32_t addr, __fsp_header * const header)
+{
+    __flash_mem_layer_status status;
+    __fmem_layer_data rdata;
+    uint8_t buf[FMEM_SPILL_HEADER_SIZE];
+
+    rdata.addr = addr;
+    rdata.buf = buf;
+    rdata.len = FMEM_SPILL_HEADER_SIZE;
+
+    status = fmem_read_data(sp->fml, &rdata);
+
+    header->seq = (uint32_t)buf[FSP_HDR_SEQ] | ((uint32_t)buf[FSP_HDR_SEQ + 1] << 8)
+            | ((uint32_t)buf[FSP_HDR_SEQ + 2] << 16) | ((uint32_t)buf[FSP_HDR_SEQ + 3] << 24);
+    header->len = (uint16_t)(buf[FSP_HDR_LEN] | (buf[FSP_HDR_LEN + 1] << 8));
+    header->crc = buf[FSP_HDR_CRC];
+    header->state = buf[FSP_HDR_STATE];
+
+    return status;
+}
+
+
+/**
+ * @brief Change state of the batch without erasing (1 -> 0)
+ *
+ * @param sp - pointer on "__fmem_spill"
+ * @param addr - address of the batch
+ * @param state - new state
+ * @return status of the flash layer
+ */
+static __flash_mem_layer_status set_state(__fmem_spill * const sp, const uint32_t addr, const uint8_t state)
+{
+    __fmem_layer_data wdata;
+    uint8_t buf[FMEM_SPILL_PREFIX_SIZE + 1];
+
+    buf[FSP_PREFIX(sp)] = state;
+
+    wdata.addr = addr + FSP_HDR_STATE;
+    wdata.buf = buf;
+    wdata.len = 1;
+
+    return fmem_change_data(sp->fml, &wdata);
+}
+
+
+/**
+ * @brief Get address of the next page with wrap
+ *
+ * @param sp - pointer on "__fmem_spill"
+ * @param addr - address of page
+ * @return address of the next page
+ */
+static uint32_t next_page(__fmem_spill * const sp, const uint32_t addr)
+{
+    const uint32_t next = addr + FSP_PAGE_SIZE(sp);
+
+    return next < FSP_MEM_SIZE(sp) ? next : 0;
+}
+
+
+/**
+ * @brief Move the read address, mark the left sector as drained.
+ *        The address isn't moved if the mark is failed, so it's retried.
+ *
+ * @param sp - pointer on "__fmem_spill"
+ * @return status of the flash layer
+ */
+static __flash_mem_layer_status advance_read(__fmem_spill * const sp)
+{
+    const uint32_t sector = FSP_SECTOR_START(sp, sp->rd_addr);
+    const uint32_t next = next_page(sp, sp->rd_addr);
+    __flash_mem_layer_status status;
+
+    if (FSP_IS_NEW_SECTOR(sp, next)) {
+        status = set_state(sp, sector, FSP_STATE_DRAINED);
+
+        if (status != FML_OK) {
+            return status;
+        }
+    }
+
+    sp->rd_addr = next;
+
+    return FML_OK;
+}
@@ -0,0 +1,159 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ *
+ * Store-and-forward queue: RAM fifo ("smfifo.h") with the overflow spilled
+ * into the flash memory block of "__fmem_layer".
+ *
+ * How to use:
+ * 1) Create "__fmem_layer" (see "flash_mem_layer.h") and "__smem_fifo_handle".
+ *
+ * 2) Initialize "__fmem_spill" and call "fmem_spill_init(...)" once after reset,
+ *    it recovers the queue from the flash.
+ *
+ * 3) Producer pushes data by "fmem_spill_push". The main loop calls
+ *    "fmem_spill_process": when the RAM fifo is filled more than threshold,
+ *    the oldest data is written to the flash by page-sized batches.
+ *
+ * 4) Consumer pops data by "fmem_spill_pop": the flash batches first (they are
+ *    older), then the RAM fifo. So the order of data is kept.
+ *
+ * Flash layout: every page is a batch with a header (sequence number, length,
+ * crc8, state). The header of the first page of a sector is the sector header.
+ * A batch is marked as consumed and a sector as drained by changing bits
+ * 1 -> 0, without erasing. The sector is erased when the writer comes into it.
+ * After reboot the head and the tail are found by the sequence numbers of
+ * the sector headers. The consumed batch may be delivered again if the power
+ * is lost before it is marked.
+ */
+
+#ifndef __FLASH_MEM_SPILL_H
+#define __FLASH_MEM_SPILL_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "flash_mem_layer.h"
+#include <smfifo.h>
+
+
+/**
+ * @brief Public API macros.
+ *
+ * @param sp - pointer to the "__fmem_spill" structure
+ */
+#define FMEM_SPILL_INIT(sp)                 fmem_spill_init((sp))
+#define FMEM_SPILL_PUSH(sp,buf,len)         fmem_spill_push((sp),(buf),(len))
+#define FMEM_SPILL_PROCESS(sp)              fmem_spill_process((sp))
+#define FMEM_SPILL_POP(sp,buf,len)          fmem_spill_pop((sp),(buf),(len))
+#define FMEM_SPILL_IS_EMPTY(sp)             fmem_spill_is_empty((sp))
+
+
+/**
+ * Size of batch header, the payload of batch is PAGE_SIZE - FMEM_SPILL_HEADER_SIZE
+ */
+#define FMEM_SPILL_HEADER_SIZE              8
+
+/**
+ * Leading bytes of the page buffer for FAST_WRITE_EN mode of the driver
+ */
+#define FMEM_SPILL_PREFIX_SIZE              4
+
+
+
+typedef enum {
+    FMEM_SPILL_OK = 0,
+    FMEM_SPILL_FULL,
+    FMEM_SPILL_FLASH_ERROR
+} __fmem_spill_status;
+
+
+/**
+ * @brief Management structure.
+ *
+ * @field fml - flash memory block, should contain 2 sectors at least
+ * @field fifo - RAM fifo
+ * @field page - buffer of PAGE_SIZE + FMEM_SPILL_PREFIX_SIZE bytes
+ * @field threshold - level of the RAM fifo to start spilling, no less than the batch
+ *                    payload to write full pages
+ *
+ * @field wr_addr / rd_addr - address of the next batch to write / read
+ * @field seq - sequence number of the next batch
+ * @field crc_errors - count of batches dropped by crc mismatch
+ * @field flash_errors - count of failed writes of the batch and sector states
+ */
+typedef struct __fmem_spill {
+    struct __fmem_layer * const fml;
+    struct __smem_fifo_handle * const fifo;
+    uint8_t * const page;
+    const uint16_t threshold;
+
+    uint32_t wr_addr;
+    uint32_t rd_addr;
+    uint32_t seq;
+    uint32_t crc_errors;
+    uint32_t flash_errors;
+} __fmem_spill;
+
+
+/**
+ * @brief Recover the queue from the flash by scanning sector headers.
+ *        The flash block never used before should be erased (FMEM_ERASE).
+ *
+ * @param sp - pointer on "__fmem_spill"
+ * @return status
+ */
+__fmem_spill_status fmem_spill_init(__fmem_spill * const sp);
+
+
+/**
+ * @brief Push data into the RAM fifo.
+ *
+ * @param sp - pointer on "__fmem_spill"
+ * @param src - data
+ * @param len - length of data
+ * @return false if the RAM fifo is full
+ */
+bool fmem_spill_push(__fmem_spill * const sp, const uint8_t * const src, const uint16_t len);
+
+
+/**
+ * @brief Spill one batch into the flash if the RAM fifo is filled more than threshold.
+ *        Call it from the main loop, it blocks for the page write (and sector erase).
+ *
+ * @param sp - pointer on "__fmem_spill"
+ * @return FMEM_SPILL_FULL if there is no free sector in the flash
+ */
+__fmem_spill_status fmem_spill_process(__fmem_spill * const sp);
+
+
+/**
+ * @brief Pop data in the FIFO order: one batch from the flash or data from the RAM fifo.
+ *
+ * @param sp - pointer on "__fmem_spill"
+ * @param dst - destination buffer, no less than the batch payload if the flash is used
+ * @param len - size of the destination buffer
+ * @return count of bytes, 0 if the queue is empty or on flash error (see "flash_errors").
+ *         The state write which is failed is retried by the next call, the batch
+ *         is returned if only the drained mark of its sector is failed
+ */
+uint16_t fmem_spill_pop(__fmem_spill * const sp, uint8_t * const dst, const uint16_t len);
+
+
+/**
+ * @brief Check the queue (flash and RAM) is empty.
+ *
+ * @param sp - pointer on "__fmem_spill"
+ * @return true if empty
+ */
+bool fmem_spill_is_empty(__fmem_spill * const sp);
+
+
+/**
+ * @brief Tests
+ */
+void fmem_spill_run_tests(void);
+
+
+
+#endif /* __FLASH_MEM_SPILL_H */
@@ -0,0 +1,635 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ */
+
+
+
+#include "flash_mem_spill.h"
+
+#include <v_printf.h>
+#include <shared_utils.h>
+
+
+static void assert(bool value, const char *error) {
+    if (!value) {
+        v_printf("Assert error:%s\r\n", error);
+
+        while(1);
+    }
+}
+
+
+#define PRINT_TEST_NAME(s)        v_printf(#s, 1)
+
+/* RAM NOR chip: 8 sectors, the spill block takes 4 of them from the sector 1 */
+#define NOR_VOLUME                0x800
+#define NOR_PAGE_SIZE             64
+#define NOR_SECTOR_SIZE           256
+
+#define SPILL_START               NOR_SECTOR_SIZE
+#define SPILL_VOLUME              (4 * NOR_SECTOR_SIZE)
+#define SPILL_PAYLOAD             (NOR_PAGE_SIZE - FMEM_SPILL_HEADER_SIZE)
+#define SPILL_BATCHES             (SPILL_VOLUME / NOR_PAGE_SIZE)
+#define SPILL_SECTOR_BATCHES      (NOR_SECTOR_SIZE / NOR_PAGE_SIZE)
+
+#define NOR_OP_READ               0x03
+#define NOR_OP_WREN               0x06
+#define NOR_OP_RDSR               0x05
+#define NOR_OP_PP                 0x02
+#define NOR_OP_SE                 0x20
+
+
+static void nor_select(void);
+static void nor_deselect(void);
+static uint32_t nor_is_spi_busy(void);
+static uint32_t nor_spi_write(const uint8_t *wbuf, const uint32_t len);
+static uint32_t nor_spi_read(const uint8_t *rbuf, const uint32_t len);
+static uint32_t nor_delay(const uint32_t delay);
+static bool nor_is_blank(const uint32_t from, const uint32_t to);
+
+static void spill_start(void);
+static void spill_reboot(void);
+static __fmem_spill_status spill_batches(uint16_t count);
+static uint16_t spill_pop_batches(uint16_t count);
+static void spill_pop_all(void);
+static uint8_t spill_state(const uint32_t addr);
+
+static void fmem_spill_wrap_test(void);
+static void fmem_spill_full_test(void);
+static void fmem_spill_crc_test(void);
+static void fmem_spill_reboot_data_test(void);
+static void fmem_spill_reboot_done_test(void);
+static void fmem_spill_reboot_drained_test(void);
+static void fmem_spill_flash_error_test(void);
+
+
+/* the chip: program only clears bits, erase sets the sector to 0xFF */
+static uint8_t nor_mem[NOR_VOLUME];
+static uint8_t nor_cmd[4];
+static uint8_t nor_cmd_len;
+static uint32_t nor_addr;
+static uint8_t nor_busy;
+static bool nor_wel;
+static bool nor_violation;
+static uint16_t nor_fail_program;
+
+static const __flash_mem_opcodes nor_opcodes = {
+    .READ_DATA = NOR_OP_READ,
+    .WRITE_EN = NOR_OP_WREN,
+    .READ_SREG = NOR_OP_RDSR,
+    .SECTOR_ERASE = NOR_OP_SE,
+    .BLOCK32_ERASE = 0x52,
+    .BLOCK64_ERASE = 0xD8,
+    .CHIP_ERASE = 0x60,
+    .PAGE_PROGRAM = NOR_OP_PP,
+    .READ_CHIP_ID = 0x9F
+};
+
+static const __flash_mem_descriptor nor_descriptor = {
+    .FLASH_MEM_VOLUME = NOR_VOLUME,
+    .PAGE_SIZE = NOR_PAGE_SIZE,
+    .SECTOR_SIZE = NOR_SECTOR_SIZE,
+    .FAST_WRITE_EN = 0,
+    .PAGE_WRITE_TIMEOUT_US = 1,
+    .SECTOR_ERASE_TIMEOUT_MS = 1,
+    .BLOCK32_ERASE_TIMEOUT_MS = 1,
+    .BLOCK64_ERASE_TIMEOUT_MS = 1,
+    .CHIP_ERASE_TIMEOUT_MS = 1
+};
+
+static const __flash_mem_api nor_api = {
+    .select = nor_select,
+    .deselect = nor_deselect,
+    .is_spi_busy = nor_is_spi_busy,
+    .spi_write = nor_spi_write,
+    .spi_read = nor_spi_read,
+    .delay = nor_delay
+};
+
+static const __flash_mem_handle nor_handle = {
+    .descriptor = &nor_descriptor,
+    .opcodes = &nor_opcodes,
+    .api = &nor_api
+};
+
+static const __fmem_layer_descriptor spill_layer_descriptor = {
+    .START_ADDRESS = SPILL_START,
+    .MEM_VOLUME = SPILL_VOLUME,
+    .fmh = &nor_handle
+};
+
+static __fmem_layer spill_layer;
+
+static uint8_t spill_fifo_buf[2 * NOR_PAGE_SIZE];
+static uint8_t spill_page[NOR_PAGE_SIZE + FMEM_SPILL_PREFIX_SIZE];
+
+static __smem_fifo_handle spill_fifo = {
+    .fifo_buf = spill_fifo_buf,
+    .fifo_size = sizeof(spill_fifo_buf)
+};
+
+static __fmem_spill spill = {
+    .fml = &spill_layer,
+    .fifo = &spill_fifo,
+    .page = spill_page,
+    .threshold = SPILL_PAYLOAD
+};
+
+/* the data is a byte counter, so the order is checked on pop */
+static uint32_t produced;
+static uint32_t consumed;
+
+
+
+void fmem_spill_run_tests(void)
+{
+    /* a new chip */
+    mem_set(nor_mem, 0xFF, sizeof(nor_mem));
+    create_fmemlayer(&spill_layer, &spill_layer_descriptor);
+
+    fmem_spill_wrap_test();
+    /*******/
+    fmem_spill_full_test();
+    /*******/
+    fmem_spill_crc_test();
+    /*******/
+    fmem_spill_reboot_data_test();
+    /*******/
+    fmem_spill_reboot_done_test();
+    /*******/
+    fmem_spill_reboot_drained_test();
+    /*******/
+    fmem_spill_flash_error_test();
+
+    v_printf("Flash mem spill tests have finished successfully\r\n", 1);
+}
+
+
+/**
+ *
+ */
+static void fmem_spill_wrap_test(void)
+{
+    PRINT_TEST_NAME(fmem_spill_wrap_test\r\n);
+
+    spill_start();
+
+    /* 2.5 sectors per round, the writer wraps on the second round */
+    for (uint16_t i = 0; i < 3; i++) {
+        assert(spill_batches(10) == FMEM_SPILL_OK, "spill: wrap batches");
+        spill_pop_all();
+    }
+
+    assert(spill.seq == 30, "spill: wrap seq");
+    assert(spill.wr_addr == (30 * NOR_PAGE_SIZE) % SPILL_VOLUME, "spill: wrap wr_addr");
+    assert(spill.rd_addr == spill.wr_addr, "spill: wrap rd_addr");
+    assert(consumed == produced, "spill: wrap lost data");
+
+    /* the writer stays in the block */
+    assert(nor_is_blank(0, SPILL_START), "spill: wrap below block");
+    assert(nor_is_blank(SPILL_START + SPILL_VOLUME, NOR_VOLUME), "spill: wrap above block");
+    assert(!nor_violation && !spill.crc_errors && !spill.flash_errors, "spill: wrap errors");
+}
+
+
+/**
+ *
+ */
+static void fmem_spill_full_test(void)
+{
+    PRINT_TEST_NAME(fmem_spill_full_test\r\n);
+
+    spill_start();
+
+    /* one page is kept free: the equal addresses are the empty queue */
+    assert(spill_batches(SPILL_BATCHES - 1) == FMEM_SPILL_OK, "spill: full batches");
+    assert(spill.wr_addr == SPILL_VOLUME - NOR_PAGE_SIZE && spill.rd_addr == 0, "spill: full addresses");
+    assert(spill_batches(1) == FMEM_SPILL_FULL, "spill: full not refused");
+
+    /* the writer comes to the start of the sector, the reader is in it */
+    assert(spill_pop_batches(1) == 1, "spill: full first pop");
+    assert(spill_batches(1) == FMEM_SPILL_OK, "spill: full last page");
+    assert(spill.wr_addr == 0 && spill.rd_addr == NOR_PAGE_SIZE, "spill: full wrapped");
+    assert(spill_batches(1) == FMEM_SPILL_FULL, "spill: full sector not refused");
+
+    /* the tail sector is full, the writer is at the start of the head sector */
+    spill_reboot();
+
+    assert(spill.wr_addr == 0 && spill.rd_addr == NOR_PAGE_SIZE, "spill: full reboot addresses");
+    assert(spill.seq == SPILL_BATCHES, "spill: full reboot seq");
+    assert(spill_batches(1) == FMEM_SPILL_FULL, "spill: full reboot not refused");
+
+    /* the reader is still in the sector, it is not erased */
+    assert(spill_pop_batches(SPILL_SECTOR_BATCHES - 2) == SPILL_SECTOR_BATCHES - 2, "spill: full pop");
+    assert(spill_batches(1) == FMEM_SPILL_FULL, "spill: full in sector");
+    assert(spill_state(0) == 0x05, "spill: full head state");
+
+    /* the sector is drained */
+    assert(spill_pop_batches(1) == 1, "spill: full last pop");
+    assert(spill.rd_addr == NOR_SECTOR_SIZE && spill_state(0) == 0x00, "spill: full drained");
+    assert(spill_batches(SPILL_SECTOR_BATCHES - 1) == FMEM_SPILL_OK, "spill: full reuse");
+    assert(spill_batches(1) == FMEM_SPILL_FULL, "spill: full second refuse");
+
+    spill_pop_all();
+
+    assert(consumed == produced, "spill: full lost data");
+    assert(!nor_violation && !spill.crc_errors && !spill.flash_errors, "spill: full errors");
+}
+
+
+/**
+ *
+ */
+static void fmem_spill_crc_test(void)
+{
+    PRINT_TEST_NAME(fmem_spill_crc_test\r\n);
+
+    uint8_t * const payload = nor_mem + SPILL_START + NOR_PAGE_SIZE + FMEM_SPILL_HEADER_SIZE;
+
+    spill_start();
+
+    assert(spill_batches(3) == FMEM_SPILL_OK, "spill: crc batches");
+
+    /* corrupt the second batch as a flash cell does: 1 -> 0 */
+    assert(payload[1] != 0, "spill: crc payload");
+    payload[1] &= (uint8_t)(payload[1] - 1);
+
+    assert(spill_pop_batches(1) == 1, "spill: crc first pop");
+
+    /* the corrupted batch is skipped, the third one is returned */
+    consumed += SPILL_PAYLOAD;
+
+    assert(spill_pop_batches(1) == 1, "spill: crc skip");
+    assert(spill.crc_errors == 1, "spill: crc counter");
+    assert(spill_state(NOR_PAGE_SIZE) == 0x05, "spill: crc batch not done");
+
+    spill_pop_all();
+
+    assert(consumed == produced, "spill: crc lost data");
+    assert(!nor_violation && !spill.flash_errors, "spill: crc errors");
+}
+
+
+/**
+ *
+ */
+static void fmem_spill_reboot_data_test(void)
+{
+    PRINT_TEST_NAME(fmem_spill_reboot_data_test\r\n);
+
+    spill_start();
+
+    assert(spill_batches(SPILL_SECTOR_BATCHES + 1) == FMEM_SPILL_OK, "spill: data batches");
+    assert(spill_state(0) == 0xA5, "spill: data state");
+
+    /* all batches are in DATA state, they are recovered */
+    spill_reboot();
+
+    assert(spill.rd_addr == 0, "spill: data rd_addr");
+    assert(spill.wr_addr == (SPILL_SECTOR_BATCHES + 1) * NOR_PAGE_SIZE, "spill: data wr_addr");
+    assert(spill.seq == SPILL_SECTOR_BATCHES + 1, "spill: data seq");
+
+    /* the writer continues after reboot */
+    assert(spill_batches(1) == FMEM_SPILL_OK, "spill: data next batch");
+
+    spill_pop_all();
+
+    assert(consumed == produced, "spill: data lost data");
+    assert(!nor_violation && !spill.crc_errors && !spill.flash_errors, "spill: data errors");
+}
+
+
+/**
+ *
+ */
+static void fmem_spill_reboot_done_test(void)
+{
+    PRINT_TEST_NAME(fmem_spill_reboot_done_test\r\n);
+
+    spill_start();
+
+    assert(spill_batches(3) == FMEM_SPILL_OK, "spill: done batches");
+    assert(spill_pop_batches(2) == 2, "spill: done pop");
+    assert(spill_state(0) == 0x05 && spill_state(NOR_PAGE_SIZE) == 0x05, "spill: done state");
+
+    /* the consumed batches are not delivered again */
+    spill_reboot();
+
+    assert(spill.rd_addr == 2 * NOR_PAGE_SIZE, "spill: done rd_addr");
+    assert(spill.wr_addr == 3 * NOR_PAGE_SIZE && spill.seq == 3, "spill: done wr_addr");
+
+    spill_pop_all();
+
+    /* all is consumed, the reader and the writer are together */
+    spill_reboot();
+
+    assert(spill.rd_addr == spill.wr_addr && spill.wr_addr == 3 * NOR_PAGE_SIZE, "spill: done empty");
+    assert(fmem_spill_is_empty(&spill), "spill: done not empty");
+
+    assert(consumed == produced, "spill: done lost data");
+    assert(!nor_violation && !spill.crc_errors && !spill.flash_errors, "spill: done errors");
+}
+
+
+/**
+ *
+ */
+static void fmem_spill_reboot_drained_test(void)
+{
+    PRINT_TEST_NAME(fmem_spill_reboot_drained_test\r\n);
+
+    spill_start();
+
+    assert(spill_batches(SPILL_SECTOR_BATCHES + 2) == FMEM_SPILL_OK, "spill: drained batches");
+    assert(spill_pop_batches(SPILL_SECTOR_BATCHES) == SPILL_SECTOR_BATCHES, "spill: drained pop");
+    assert(spill_state(0) == 0x00, "spill: drained state");
+
+    /* the drained sector is not the head */
+    spill_reboot();
+
+    assert(spill.rd_addr == NOR_SECTOR_SIZE, "spill: drained rd_addr");
+    assert(spill.wr_addr == NOR_SECTOR_SIZE + 2 * NOR_PAGE_SIZE, "spill: drained wr_addr");
+    assert(spill.seq == SPILL_SECTOR_BATCHES + 2, "spill: drained seq");
+
+    /* the tail sector is full and drained: the writer goes to the next sector */
+    assert(spill_batches(SPILL_SECTOR_BATCHES - 2) == FMEM_SPILL_OK, "spill: drained fill");
+
+    spill_pop_all();
+
+    assert(spill_state(NOR_SECTOR_SIZE) == 0x00, "spill: drained tail state");
+
+    spill_reboot();
+
+    assert(spill.rd_addr == spill.wr_addr && spill.wr_addr == 2 * NOR_SECTOR_SIZE, "spill: drained wr_addr");
+    assert(spill.seq == 2 * SPILL_SECTOR_BATCHES, "spill: drained next seq");
+    assert(spill_batches(1) == FMEM_SPILL_OK, "spill: drained next batch");
+
+    spill_pop_all();
+
+    assert(consumed == produced, "spill: drained lost data");
+    assert(!nor_violation && !spill.crc_errors && !spill.flash_errors, "spill: drained errors");
+}
+
+
+/**
+ *
+ */
+static void fmem_spill_flash_error_test(void)
+{
+    PRINT_TEST_NAME(fmem_spill_flash_error_test\r\n);
+
+    spill_start();
+
+    assert(spill_batches(SPILL_SECTOR_BATCHES + 1) == FMEM_SPILL_OK, "spill: flash error batches");
+    assert(spill_pop_batches(SPILL_SECTOR_BATCHES - 1) == SPILL_SECTOR_BATCHES - 1, "spill: flash error pop");
+
+    /* the DONE mark is failed: the batch stays in the flash */
+    nor_fail_program = 1;
+
+    assert(!fmem_spill_pop(&spill, spill_page, sizeof(spill_page)), "spill: flash error done");
+    assert(spill.flash_errors == 1 && spill_state((SPILL_SECTOR_BATCHES - 1) * NOR_PAGE_SIZE) == 0xA5,
+            "spill: flash error done state");
+
+    /* the DRAINED mark is failed: the batch is returned, the reader isn't moved */
+    nor_fail_program = 2;
+
+    assert(spill_pop_batches(1) == 1, "spill: flash error drained");
+    assert(spill.flash_errors == 2 && spill_state(0) == 0x05, "spill: flash error drained state");
+    assert(spill.rd_addr == (SPILL_SECTOR_BATCHES - 1) * NOR_PAGE_SIZE, "spill: flash error rd_addr");
+
+    /* the mark is retried */
+    spill_pop_all();
+
+    assert(spill_state(0) == 0x00, "spill: flash error retry");
+    assert(consumed == produced, "spill: flash error lost data");
+    assert(!nor_violation && !spill.crc_errors && spill.flash_errors == 2, "spill: flash error errors");
+}
+
+
+/**
+ *
+ */
+static void spill_start(void)
+{
+    smfifo_flush(&spill_fifo);
+    assert(FMEM_ERASE(&spill_layer) == FML_OK, "spill: erase");
+    assert(FMEM_SPILL_INIT(&spill) == FMEM_SPILL_OK, "spill: init on erased");
+    assert(!spill.wr_addr && !spill.rd_addr && !spill.seq, "spill: init on erased addresses");
+
+    produced = consumed = 0;
+}
+
+
+/**
+ *
+ */
+static void spill_reboot(void)
+{
+    /* the RAM fifo is lost, the producer repeats it */
+    produced -= smfifo_filled_space(&spill_fifo);
+    smfifo_flush(&spill_fifo);
+
+    assert(FMEM_SPILL_INIT(&spill) == FMEM_SPILL_OK, "spill: init");
+}
+
+
+/**
+ *
+ */
+static __fmem_spill_status spill_batches(uint16_t count)
+{
+    __fmem_spill_status status = FMEM_SPILL_OK;
+    uint8_t data[8];
+
+    while (count-- && status == FMEM_SPILL_OK) {
+        while (smfifo_filled_space(&spill_fifo) <= SPILL_PAYLOAD) {
+            for (uint16_t i = 0; i < sizeof(data); i++) {
+                data[i] = (uint8_t)produced++;
+            }
+
+            assert(FMEM_SPILL_PUSH(&spill, data, sizeof(data)), "spill: push");
+        }
+
+        status = FMEM_SPILL_PROCESS(&spill);
+    }
+
+    return status;
+}
+
+
+/**
+ *
+ */
+static uint16_t spill_pop_batches(uint16_t count)
+{
+    uint8_t data[SPILL_PAYLOAD];
+    uint16_t popped = 0;
+    uint16_t len;
+
+    while (count-- && spill.rd_addr != spill.wr_addr) {
+        len = FMEM_SPILL_POP(&spill, data, sizeof(data));
+
+        assert(len == SPILL_PAYLOAD, "spill: pop batch len");
+
+        for (uint16_t i = 0; i < len; i++) {
+            assert(data[i] == (uint8_t)consumed++, "spill: pop order");
+        }
+
+        popped++;
+    }
+
+    return popped;
+}
+
+
+/**
+ *
+ */
+static void spill_pop_all(void)
+{
+    uint8_t data[SPILL_PAYLOAD];
+    uint16_t len;
+
+    while ((len = FMEM_SPILL_POP(&spill, data, sizeof(data)))) {
+        for (uint16_t i = 0; i < len; i++) {
+            assert(data[i] == (uint8_t)consumed++, "spill: pop all order");
+        }
+    }
+
+    assert(FMEM_SPILL_IS_EMPTY(&spill), "spill: pop all not empty");
+}
+
+
+/**
+ *
+ */
+static uint8_t spill_state(const uint32_t addr)
+{
+    return nor_mem[SPILL_START + addr + FMEM_SPILL_HEADER_SIZE - 1];
+}
+
+
+/**
+ *
+ */
+static void nor_select(void)
+{
+    nor_cmd_len = 0;
+}
+
+
+/**
+ *
+ */
+static void nor_deselect(void)
+{
+    if (nor_cmd_len == 4 && nor_cmd[0] == NOR_OP_SE) {
+        nor_violation |= !nor_wel || nor_busy;
+        mem_set(nor_mem + nor_addr - nor_addr % NOR_SECTOR_SIZE, 0xFF, NOR_SECTOR_SIZE);
+        nor_busy = 3;
+        nor_wel = false;
+    } else if (nor_cmd_len == 4 && nor_cmd[0] == NOR_OP_PP) {
+        nor_busy = 1;
+        nor_wel = false;
+    }
+}
+
+
+/**
+ *
+ */
+static uint32_t nor_is_spi_busy(void)
+{
+    return 0;
+}
+
+
+/**
+ *
+ */
+static uint32_t nor_spi_write(const uint8_t *wbuf, const uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        if (nor_cmd_len < 4) {
+            nor_cmd[nor_cmd_len++] = wbuf[i];
+
+            if (nor_cmd_len == 1 && nor_cmd[0] == NOR_OP_WREN) {
+                nor_wel = true;
+            }
+
+            if (nor_cmd_len == 4) {
+                nor_addr = ((uint32_t)nor_cmd[1] << 16) | ((uint32_t)nor_cmd[2] << 8) | nor_cmd[3];
+                nor_violation |= nor_addr >= NOR_VOLUME;
+                nor_addr %= NOR_VOLUME;
+
+                /* fail the n-th program command */
+                if (nor_cmd[0] == NOR_OP_PP && nor_fail_program && !--nor_fail_program) {
+                    nor_cmd_len = 0;
+                    return 1;
+                }
+            }
+
+        } else if (nor_cmd[0] == NOR_OP_PP) {
+            /* the page program wraps inside of the page */
+            nor_violation |= !nor_wel || nor_busy;
+            nor_mem[nor_addr] &= wbuf[i];
+            nor_addr = nor_addr - nor_addr % NOR_PAGE_SIZE + (nor_addr + 1) % NOR_PAGE_SIZE;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ *
+ */
+static uint32_t nor_spi_read(const uint8_t *rbuf, const uint32_t len)
+{
+    uint8_t * const buf = (uint8_t *)rbuf;
+
+    if (nor_cmd[0] == NOR_OP_RDSR) {
+        buf[0] = (nor_busy ? 0x01 : 0) | (nor_wel ? 0x02 : 0);
+
+        if (nor_busy) {
+            nor_busy--;
+        }
+
+        return 0;
+    }
+
+    if (nor_cmd[0] == NOR_OP_READ && nor_cmd_len == 4) {
+        nor_violation |= nor_busy || nor_addr + len > NOR_VOLUME;
+        mem_copy(buf, nor_mem + nor_addr, len);
+
+        return 0;
+    }
+
+    return 1;
+}
+
+
+/**
+ *
+ */
+static uint32_t nor_delay(const uint32_t delay)
+{
+    (void)delay;
+
+    return 0;
+}
+
+
+/**
+ *
+ */
+static bool nor_is_blank(const uint32_t from, const uint32_t to)
+{
+    for (uint32_t i = from; i < to; i++) {
+        if (nor_mem[i] != 0xFF) {
+            return false;
+        }
+    }
+
+    return true;
+}
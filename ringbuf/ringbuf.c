@@ -5,6 +5,27 @@
 
 #include "ringbuf.h"
 
+#include <shared_utils.h>
+
+
+/**
+ * Private macros
+ *
+ * The SPSC indices are published with acquire/release semantic.
+ * Builtins are supported by gcc/clang on both targets (arm-none-eabi) and host.
+ */
+#define RB_LOAD_RELAXED(v)         __atomic_load_n(&(v), __ATOMIC_RELAXED)
+#define RB_LOAD_ACQUIRE(v)         __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define RB_STORE_RELEASE(v,x)      __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#define RB_STORE_RELAXED(v,x)      __atomic_store_n(&(v), (x), __ATOMIC_RELAXED)
+#define RB_CAS(v,pexp,x)           __atomic_compare_exchange_n(&(v), (pexp), (x), \
+                                           false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+
+#define RB_SPSC_MAX_SIZE           0x8000
+
+/* the data is mapped twice back-to-back, any span is contiguous */
+#define RB_CONTIGUOUS(r,pos)       ((r)->mirrored ? (r)->sz : (r)->sz - (pos))
+
 
 static void inc_tile(__ringbuf * const r);
 static void inc_head(__ringbuf * const r);
@@ -12,6 +33,16 @@ static void __reset(struct __ringbuf * const r);
 static void __put(struct __ringbuf * const r, const uint8_t c);
 static uint16_t __size(struct __ringbuf * const r);
 static uint8_t __get(struct __ringbuf * const r);
+static void __spsc_reset(struct __ringbuf * const r);
+static void __spsc_put(struct __ringbuf * const r, const uint8_t c);
+static uint16_t __spsc_size(struct __ringbuf * const r);
+static uint8_t __spsc_get(struct __ringbuf * const r);
+static uint16_t write_space(__ringbuf * const r, uint16_t * const pos);
+static uint16_t read_space(__ringbuf * const r, uint16_t * const head, uint16_t * const pos);
+static void write_advance(__ringbuf * const r, const uint16_t len);
+static bool read_advance(__ringbuf * const r, const uint16_t head, const uint16_t len);
+static void drop_oldest(__ringbuf * const r, const uint16_t len);
+static void count_drops(__ringbuf * const r, const uint16_t len);
 
 
 void init_ringbuf(__ringbuf * const r, uint8_t * const data, const uint16_t size)
@@ -20,6 +51,12 @@ void init_ringbuf(__ringbuf * const r, uint8_t * const data, const uint16_t size
     r->sz = size;
     r->tile = 0;
     r->head = 0;
+    r->mask = 0;
+    r->policy = RINGBUF_REJECT_NEWEST;
+    r->mirrored = false;
+    r->drops = 0;
+
+    QSTAT_RESET(&r->stats);
 
     /* initialize interface */
     r->reset = __reset;
@@ -29,6 +66,211 @@ void init_ringbuf(__ringbuf * const r, uint8_t * const data, const uint16_t size
 }
 
 
+bool init_ringbuf_spsc(__ringbuf * const r, uint8_t * const data, const uint16_t size)
+{
+    /* mask 0 is the tag of the legacy mode */
+    if (size < 2 || size > RB_SPSC_MAX_SIZE || (size & (size - 1))) {
+        return false;
+    }
+
+    r->data = data;
+    r->sz = size;
+    r->tile = 0;
+    r->head = 0;
+    r->mask = size - 1;
+    r->policy = RINGBUF_REJECT_NEWEST;
+    r->mirrored = false;
+    r->drops = 0;
+
+    QSTAT_RESET(&r->stats);
+
+    /* initialize interface */
+    r->reset = __spsc_reset;
+    r->put = __spsc_put;
+    r->get = __spsc_get;
+    r->size = __spsc_size;
+
+    return true;
+}
+
+
+/**
+ *
+ */
+void ringbuf_set_policy(__ringbuf * const r, const __ringbuf_policy policy)
+{
+    r->policy = policy;
+}
+
+
+/**
+ *
+ */
+void ringbuf_set_mirrored(__ringbuf * const r)
+{
+    r->mirrored = true;
+}
+
+
+/**
+ *
+ */
+uint32_t ringbuf_get_drops(__ringbuf * const r)
+{
+    return RB_LOAD_RELAXED(r->drops);
+}
+
+
+/**
+ *
+ */
+uint16_t ringbuf_put_block(__ringbuf * const r, const uint8_t * const src, const uint16_t len)
+{
+    const uint16_t capacity = r->mask ? r->sz : r->sz - 1;
+    const uint8_t * block;
+    uint16_t pos;
+    uint16_t cnt;
+    uint16_t run;
+
+    block = src;
+    cnt = len;
+
+    if (r->policy == RINGBUF_OVERWRITE_OLDEST) {
+        /* only the newest "capacity" bytes survive */
+        if (cnt > capacity) {
+            count_drops(r, cnt - capacity);
+
+            block += cnt - capacity;
+            cnt = capacity;
+        }
+
+        drop_oldest(r, cnt);
+    }
+
+    run = write_space(r, &pos);
+
+    if (cnt > run) {
+        count_drops(r, cnt - run);
+        cnt = run;
+    }
+
+    if (cnt) {
+        run = RB_CONTIGUOUS(r, pos);
+        run = cnt < run ? cnt : run;
+
+        mem_copy(r->data + pos, block, run);
+        mem_copy(r->data, block + run, cnt - run);
+
+        write_advance(r, cnt);
+    }
+
+    return cnt;
+}
+
+
+/**
+ *
+ */
+uint16_t ringbuf_get_block(__ringbuf * const r, uint8_t * const dst, const uint16_t len)
+{
+    uint16_t head;
+    uint16_t pos;
+    uint16_t cnt;
+    uint16_t run;
+
+    /* repeat if the producer has overwritten the oldest data meanwhile */
+    do {
+        cnt = read_space(r, &head, &pos);
+        cnt = len < cnt ? len : cnt;
+
+        if (!cnt) {
+            break;
+        }
+
+        run = RB_CONTIGUOUS(r, pos);
+        run = cnt < run ? cnt : run;
+
+        mem_copy(dst, r->data + pos, run);
+        mem_copy(dst + run, r->data, cnt - run);
+
+    } while (!read_advance(r, head, cnt));
+
+    if (!cnt && len) {
+        QSTAT_UNDERFLOW(&r->stats);
+    }
+
+    return cnt;
+}
+
+
+/**
+ *
+ */
+uint16_t ringbuf_write_acquire(__ringbuf * const r, uint8_t ** const region)
+{
+    uint16_t pos;
+    uint16_t cnt;
+
+    cnt = write_space(r, &pos);
+    cnt = cnt < RB_CONTIGUOUS(r, pos) ? cnt : RB_CONTIGUOUS(r, pos);
+
+    *region = cnt ? r->data + pos : NULL;
+
+    return cnt;
+}
+
+
+/**
+ *
+ */
+bool ringbuf_write_commit(__ringbuf * const r, const uint16_t len)
+{
+    uint16_t pos;
+
+    if (len > write_space(r, &pos) || len > RB_CONTIGUOUS(r, pos)) {
+        return false;
+    }
+
+    write_advance(r, len);
+
+    return true;
+}
+
+
+/**
+ *
+ */
+uint16_t ringbuf_read_peek(__ringbuf * const r, const uint8_t ** const region)
+{
+    uint16_t head;
+    uint16_t pos;
+    uint16_t cnt;
+
+    cnt = read_space(r, &head, &pos);
+    cnt = cnt < RB_CONTIGUOUS(r, pos) ? cnt : RB_CONTIGUOUS(r, pos);
+
+    *region = cnt ? r->data + pos : NULL;
+
+    return cnt;
+}
+
+
+/**
+ *
+ */
+bool ringbuf_read_release(__ringbuf * const r, const uint16_t len)
+{
+    uint16_t head;
+    uint16_t pos;
+
+    if (len > read_space(r, &head, &pos) || len > RB_CONTIGUOUS(r, pos)) {
+        return false;
+    }
+
+    return read_advance(r, head, len);
+}
+
+
 /**
  * @brief Increment tile
  *
@@ -82,8 +324,20 @@ static void inc_head(__ringbuf * const r)
  */
 static void __put(struct __ringbuf * const r, const uint8_t c)
 {
+    if (__size(r) == r->sz - 1) {
+        count_drops(r, 1);
+
+        if (r->policy == RINGBUF_REJECT_NEWEST) {
+            return;
+        }
+
+        inc_head(r);
+    }
+
     r->data[r->tile] = c;
     inc_tile(r);
+
+    QSTAT_PUSH(&r->stats, 1, __size(r));
 }
 
 
@@ -96,6 +350,12 @@ static uint8_t __get(struct __ringbuf * const r)
 {
     const uint8_t byte = r->data[r->head];
 
+    if (__size(r)) {
+        QSTAT_POP(&r->stats, 1);
+    } else {
+        QSTAT_UNDERFLOW(&r->stats);
+    }
+
     inc_head(r);
 
     return byte;
@@ -127,3 +387,254 @@ static void __reset(struct __ringbuf * const r)
     r->tile = 0;
     r->head = 0;
 }
+
+
+/**
+ * @brief Put data in buf (SPSC mode, producer side).
+ *        The byte is discarded if buf is full.
+ *
+ * @param r - pinter on the __ringbuf
+ * @param c - data byte
+ */
+static void __spsc_put(struct __ringbuf * const r, const uint8_t c)
+{
+    const uint16_t tile = RB_LOAD_RELAXED(r->tile);
+    uint16_t head = RB_LOAD_ACQUIRE(r->head);
+
+    while ((uint16_t)(tile - head) >= r->sz) {
+        if (r->policy == RINGBUF_REJECT_NEWEST) {
+            count_drops(r, 1);
+            return;
+        }
+
+        /* the consumer moves head concurrently */
+        if (RB_CAS(r->head, &head, (uint16_t)(head + 1))) {
+            count_drops(r, 1);
+            break;
+        }
+    }
+
+    r->data[tile & r->mask] = c;
+
+    /* sample before publishing, the consumer may pop the byte at once */
+    QSTAT_PUSH(&r->stats, 1, (uint16_t)(tile + 1 - RB_LOAD_ACQUIRE(r->head)));
+
+    RB_STORE_RELEASE(r->tile, (uint16_t)(tile + 1));
+}
+
+
+/**
+ * @brief Get data byte from buf (SPSC mode, consumer side).
+ *        Returns 0 if buf is empty.
+ *
+ * @param r - pinter on the __ringbuf
+ */
+static uint8_t __spsc_get(struct __ringbuf * const r)
+{
+    uint16_t head;
+    uint8_t byte;
+
+    do {
+        head = RB_LOAD_ACQUIRE(r->head);
+
+        if (RB_LOAD_ACQUIRE(r->tile) == head) {
+            QSTAT_UNDERFLOW(&r->stats);
+            return 0;
+        }
+
+        byte = r->data[head & r->mask];
+    } while (!read_advance(r, head, 1));
+
+    return byte;
+}
+
+
+/**
+ * @brief Get data size (SPSC mode)
+ *
+ * @param r - pinter on the __ringbuf
+ */
+static uint16_t __spsc_size(struct __ringbuf * const r)
+{
+    const uint16_t head = RB_LOAD_ACQUIRE(r->head);
+
+    return (uint16_t)(RB_LOAD_ACQUIRE(r->tile) - head);
+}
+
+
+/**
+ * @brief Reset ring buff (SPSC mode). Both sides should be stopped.
+ *
+ * @param r - pinter on the __ringbuf
+ */
+static void __spsc_reset(struct __ringbuf * const r)
+{
+    RB_STORE_RELEASE(r->tile, 0);
+    RB_STORE_RELEASE(r->head, 0);
+}
+
+
+/**
+ * @brief Get free space and write position (producer side)
+ *
+ * @param r - pinter on the __ringbuf
+ * @param pos - offset of the first free byte in the data
+ * @return free space
+ */
+static uint16_t write_space(__ringbuf * const r, uint16_t * const pos)
+{
+    uint16_t tile;
+
+    if (r->mask) {
+        tile = RB_LOAD_RELAXED(r->tile);
+        *pos = tile & r->mask;
+
+        return r->sz - (uint16_t)(tile - RB_LOAD_ACQUIRE(r->head));
+    }
+
+    /* legacy mode keeps one slot free */
+    *pos = r->tile;
+
+    return r->sz - 1 - __size(r);
+}
+
+
+/**
+ * @brief Get filled space and read position (consumer side)
+ *
+ * @param r - pinter on the __ringbuf
+ * @param head - snapshot of head for read_advance()
+ * @param pos - offset of the first data byte
+ * @return filled space
+ */
+static uint16_t read_space(__ringbuf * const r, uint16_t * const head, uint16_t * const pos)
+{
+    if (r->mask) {
+        /* the producer moves head in the overwrite mode */
+        *head = RB_LOAD_ACQUIRE(r->head);
+        *pos = *head & r->mask;
+
+        return (uint16_t)(RB_LOAD_ACQUIRE(r->tile) - *head);
+    }
+
+    *head = r->head;
+    *pos = r->head;
+
+    return __size(r);
+}
+
+
+/**
+ * @brief Move tile forward, len should be no more than free space
+ *
+ * @param r - pinter on the __ringbuf
+ * @param len - count of written bytes
+ */
+static void write_advance(__ringbuf * const r, const uint16_t len)
+{
+    uint32_t tile;
+
+    if (r->mask) {
+        tile = (uint16_t)(RB_LOAD_RELAXED(r->tile) + len);
+
+        /* sample before publishing, the consumer may pop the data at once */
+        QSTAT_PUSH(&r->stats, len, (uint16_t)(tile - RB_LOAD_ACQUIRE(r->head)));
+
+        RB_STORE_RELEASE(r->tile, (uint16_t)tile);
+    } else {
+        tile = (uint32_t)r->tile + len;
+        r->tile = tile >= r->sz ? tile - r->sz : tile;
+
+        QSTAT_PUSH(&r->stats, len, __size(r));
+    }
+}
+
+
+/**
+ * @brief Move head forward, len should be no more than filled space
+ *
+ * @param r - pinter on the __ringbuf
+ * @param head - snapshot of head from read_space()
+ * @param len - count of read bytes
+ * @return false if the producer has dropped the data meanwhile (SPSC overwrite mode)
+ */
+static bool read_advance(__ringbuf * const r, const uint16_t head, const uint16_t len)
+{
+    uint16_t expected;
+    uint32_t next;
+
+    if (r->mask) {
+        if (r->policy == RINGBUF_OVERWRITE_OLDEST) {
+            expected = head;
+            if (!RB_CAS(r->head, &expected, (uint16_t)(head + len))) {
+                return false;
+            }
+        } else {
+            RB_STORE_RELEASE(r->head, (uint16_t)(head + len));
+        }
+    } else {
+        next = (uint32_t)head + len;
+        r->head = next >= r->sz ? next - r->sz : next;
+
+        /* the same as inc_head(), drained buffer starts from 0 */
+        if (r->tile == r->head) {
+            r->tile = 0;
+            r->head = 0;
+        }
+    }
+
+    QSTAT_POP(&r->stats, len);
+
+    return true;
+}
+
+
+/**
+ * @brief Drop the oldest data until len bytes are free (producer side)
+ *
+ * @param r - pinter on the __ringbuf
+ * @param len - required free space, no more than capacity
+ */
+static void drop_oldest(__ringbuf * const r, const uint16_t len)
+{
+    uint16_t tile;
+    uint16_t head;
+    uint16_t space;
+    uint32_t next;
+
+    if (r->mask) {
+        tile = RB_LOAD_RELAXED(r->tile);
+        head = RB_LOAD_ACQUIRE(r->head);
+
+        /* the consumer moves head concurrently */
+        while ((space = r->sz - (uint16_t)(tile - head)) < len) {
+            if (RB_CAS(r->head, &head, (uint16_t)(head + len - space))) {
+                count_drops(r, len - space);
+                break;
+            }
+        }
+    } else {
+        space = r->sz - 1 - __size(r);
+
+        if (space < len) {
+            next = (uint32_t)r->head + len - space;
+            r->head = next >= r->sz ? next - r->sz : next;
+
+            count_drops(r, len - space);
+        }
+    }
+}
+
+
+/**
+ * @brief Update drop counter, it's written by the producer only
+ *
+ * @param r - pinter on the __ringbuf
+ * @param len - count of dropped bytes
+ */
+static void count_drops(__ringbuf * const r, const uint16_t len)
+{
+    QSTAT_OVERFLOW(&r->stats);
+
+    RB_STORE_RELAXED(r->drops, RB_LOAD_RELAXED(r->drops) + len);
+}
@@ -7,6 +7,14 @@
 
 
 #include <stdint.h>
+#include <stdbool.h>
+
+#include <qstat.h>
+
+
+#ifndef NULL
+#define NULL ((void *)0)
+#endif
 
 
 /**
@@ -17,7 +25,31 @@
  * This struct is an opaque structure with no user-visible elements.
  *
  * !!! Be carefully with race conditions.
+ *
+ * The buffer works in one of two modes:
+ *
+ * 1) Legacy mode ("init_ringbuf"). Any size, one slot is always kept free.
+ *    Not safe for the concurrent put/get.
+ *
+ * 2) SPSC mode ("init_ringbuf_spsc"). Size should be a power of two.
+ *    "tile" and "head" are free-running indices, the wrap is a mask.
+ *    One producer (e.g. UART ISR) and one consumer (e.g. main loop) may work
+ *    with the buffer concurrently without locks: "tile" is written only by
+ *    the producer, "head" only by the consumer, both are published with
+ *    acquire/release atomics.
+ */
+
+
+/**
+ * @brief Policy of put into the full buffer
+ *
+ * RINGBUF_REJECT_NEWEST - the new data is discarded (default)
+ * RINGBUF_OVERWRITE_OLDEST - head is moved forward, the oldest data is discarded
  */
+typedef enum {
+    RINGBUF_REJECT_NEWEST = 0,
+    RINGBUF_OVERWRITE_OLDEST
+} __ringbuf_policy;
 
 
 typedef struct __ringbuf {
@@ -27,6 +59,21 @@ typedef struct __ringbuf {
     uint16_t tile;
     uint16_t head;
 
+    /* sz - 1 in the SPSC mode, 0 in the legacy mode */
+    uint16_t mask;
+
+    /* policy of put into the full buffer and counter of discarded bytes */
+    uint8_t policy;
+    uint32_t drops;
+
+    /* data is double-mapped, see "vmring_map" */
+    bool mirrored;
+
+#ifdef QSTAT_EN
+    /* instrumentation, see "qstat.h" */
+    __qstat stats;
+#endif
+
     /* interface */
     void (* reset)(struct __ringbuf * const r);
     void (* put)(struct __ringbuf * const r, const uint8_t c);
@@ -45,6 +92,14 @@ typedef struct __ringbuf {
 #define put_ringbuf(r,c)   r.put(&r,c)
 #define get_ringbuf(r)     r.get(&r)
 
+#define put_block_ringbuf(r,buf,len)    ringbuf_put_block(&r,(buf),(len))
+#define get_block_ringbuf(r,buf,len)    ringbuf_get_block(&r,(buf),(len))
+
+#define write_acquire_ringbuf(r,pbuf)   ringbuf_write_acquire(&r,(pbuf))
+#define write_commit_ringbuf(r,len)     ringbuf_write_commit(&r,(len))
+#define read_peek_ringbuf(r,pbuf)       ringbuf_read_peek(&r,(pbuf))
+#define read_release_ringbuf(r,len)     ringbuf_read_release(&r,(len))
+
 
 /**
  * @brief Initialize new ring buffer
@@ -56,4 +111,130 @@ typedef struct __ringbuf {
 void init_ringbuf(__ringbuf * const r, uint8_t * const data, const uint16_t size);
 
 
+/**
+ * @brief Initialize new lock-free single-producer/single-consumer ring buffer.
+ *        A put into the full buffer discards the byte, a get from the empty
+ *        buffer returns 0. The reset is not thread-safe.
+ *
+ * @param r - pinter on the __ringbuf struct
+ * @param data - pointer on data buffer
+ * @param size - size of buffer, power of two, from 2 to 32768
+ * @return false if size is wrong
+ */
+bool init_ringbuf_spsc(__ringbuf * const r, uint8_t * const data, const uint16_t size);
+
+
+/**
+ * @brief Select policy of put into the full buffer. Call it before start of producer.
+ *
+ *        In the SPSC mode with RINGBUF_OVERWRITE_OLDEST the producer moves head by
+ *        compare-and-swap, get/get_block retry if their data has been overwritten.
+ *        The zero-copy read API should not be used concurrently in this case.
+ *
+ * @param r - pinter on the __ringbuf struct
+ * @param policy - policy
+ */
+void ringbuf_set_policy(__ringbuf * const r, const __ringbuf_policy policy);
+
+
+/**
+ * @brief Mark the data buffer as double-mapped (the same memory is mapped twice
+ *        back-to-back, see "vmring_map" on Linux host). Then block and zero-copy
+ *        API don't split data at the wrap point: the regions returned by
+ *        "ringbuf_write_acquire" and "ringbuf_read_peek" run over the end of
+ *        data into the mirror. The size of buffer should be equal to the mapped size.
+ *
+ * @param r - pinter on the __ringbuf struct
+ */
+void ringbuf_set_mirrored(__ringbuf * const r);
+
+
+/**
+ * @brief Get count of bytes discarded by the policy. The counter is free-running,
+ *        so the consumer may calculate loss by difference of two readings.
+ *
+ * @param r - pinter on the __ringbuf struct
+ * @return count of discarded bytes
+ */
+uint32_t ringbuf_get_drops(__ringbuf * const r);
+
+
+/**
+ * @brief Put a block of data in buf. Works in both modes (producer side in SPSC).
+ *        Data is copied by no more than two chunks around the wrap point.
+ *
+ * @param r - pinter on the __ringbuf struct
+ * @param src - pointer on data
+ * @param len - length of data
+ * @return count of bytes which were put, less than len if buf became full
+ *         (in the overwrite mode the oldest data is dropped instead)
+ */
+uint16_t ringbuf_put_block(__ringbuf * const r, const uint8_t * const src, const uint16_t len);
+
+
+/**
+ * @brief Get a block of data from buf. Works in both modes (consumer side in SPSC).
+ *        Data is copied by no more than two chunks around the wrap point.
+ *
+ * @param r - pinter on the __ringbuf struct
+ * @param dst - pointer on destination buffer
+ * @param len - size of destination buffer
+ * @return count of bytes which were got, less than len if buf became empty
+ */
+uint16_t ringbuf_get_block(__ringbuf * const r, uint8_t * const dst, const uint16_t len);
+
+
+/**
+ * @brief Zero-copy API (e.g. for DMA).
+ *        Get the largest contiguous free region of buf. The region ends at the
+ *        wrap point, the rest of free space is returned by the next call after commit.
+ *
+ *        Legacy mode: don't get data from buf between acquire and commit,
+ *        the drained buffer restarts from 0. Use the SPSC mode for RX DMA
+ *        which works concurrently with the consumer.
+ *
+ * @param r - pinter on the __ringbuf struct
+ * @param region - pointer on the region start, NULL if buf is full
+ * @return length of the region
+ */
+uint16_t ringbuf_write_acquire(__ringbuf * const r, uint8_t ** const region);
+
+
+/**
+ * @brief Zero-copy API. Publish len bytes written into the acquired region.
+ *
+ * @param r - pinter on the __ringbuf struct
+ * @param len - count of written bytes, no more than the region length
+ * @return false if len is more than the region length
+ */
+bool ringbuf_write_commit(__ringbuf * const r, const uint16_t len);
+
+
+/**
+ * @brief Zero-copy API. Get the largest contiguous region of data (e.g. for TX DMA).
+ *
+ * @param r - pinter on the __ringbuf struct
+ * @param region - pointer on the region start, NULL if buf is empty
+ * @return length of the region
+ */
+uint16_t ringbuf_read_peek(__ringbuf * const r, const uint8_t ** const region);
+
+
+/**
+ * @brief Zero-copy API. Release len bytes of the peeked region.
+ *
+ * @param r - pinter on the __ringbuf struct
+ * @param len - count of consumed bytes, no more than the region length
+ * @return false if len is more than the region length
+ */
+bool ringbuf_read_release(__ringbuf * const r, const uint16_t len);
+
+
+/**
+ * @brief Tests. Define RINGBUF_HOST_TESTS and link with pthread
+ *        to run the SPSC stress test on the host.
+ */
+void ringbuf_run_tests(void);
+
+
 #endif /* __RINGBUF_H */
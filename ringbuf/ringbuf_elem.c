@@ -0,0 +1,201 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ */
+
+
+#include "ringbuf_elem.h"
+
+
+/**
+ * Private macros
+ *
+ */
+#define RB_LOAD_RELAXED(v)         __atomic_load_n(&(v), __ATOMIC_RELAXED)
+#define RB_LOAD_ACQUIRE(v)         __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define RB_STORE_RELEASE(v,x)      __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+
+#define RB_ELEM_MAX_COUNT          0x8000
+#define RB_ELEM_PTR(r,idx)         ((r)->data + (uint32_t)((idx) & ((r)->count - 1)) * (r)->elem_size)
+
+
+static void elem_copy(void * dst, const void * src, const uint32_t len);
+static void batch_copy(__ringbuf_elem * const r, uint8_t * dst, const uint8_t * src,
+        const uint16_t idx, const uint16_t n, const bool to_ring);
+
+
+
+/**
+ *
+ */
+bool init_ringbuf_elem(__ringbuf_elem * const r, void * const data, const uint16_t elem_size, const uint16_t count)
+{
+    if (!elem_size || !count || count > RB_ELEM_MAX_COUNT || (count & (count - 1))) {
+        return false;
+    }
+
+    r->data = (uint8_t *)data;
+    r->elem_size = elem_size;
+    r->count = count;
+    r->tile = 0;
+    r->head = 0;
+
+    return true;
+}
+
+
+/**
+ *
+ */
+void ringbuf_elem_reset(__ringbuf_elem * const r)
+{
+    RB_STORE_RELEASE(r->tile, 0);
+    RB_STORE_RELEASE(r->head, 0);
+}
+
+
+/**
+ *
+ */
+uint16_t ringbuf_elem_size(__ringbuf_elem * const r)
+{
+    const uint16_t head = RB_LOAD_ACQUIRE(r->head);
+
+    return (uint16_t)(RB_LOAD_ACQUIRE(r->tile) - head);
+}
+
+
+/**
+ *
+ */
+bool ringbuf_elem_put(__ringbuf_elem * const r, const void * const elem)
+{
+    const uint16_t tile = RB_LOAD_RELAXED(r->tile);
+
+    if ((uint16_t)(tile - RB_LOAD_ACQUIRE(r->head)) >= r->count) {
+        return false;
+    }
+
+    elem_copy(RB_ELEM_PTR(r, tile), elem, r->elem_size);
+    RB_STORE_RELEASE(r->tile, (uint16_t)(tile + 1));
+
+    return true;
+}
+
+
+/**
+ *
+ */
+bool ringbuf_elem_get(__ringbuf_elem * const r, void * const elem)
+{
+    const uint16_t head = RB_LOAD_RELAXED(r->head);
+
+    if (RB_LOAD_ACQUIRE(r->tile) == head) {
+        return false;
+    }
+
+    elem_copy(elem, RB_ELEM_PTR(r, head), r->elem_size);
+    RB_STORE_RELEASE(r->head, (uint16_t)(head + 1));
+
+    return true;
+}
+
+
+/**
+ *
+ */
+uint16_t ringbuf_elem_put_batch(__ringbuf_elem * const r, const void * const src, const uint16_t n)
+{
+    const uint16_t tile = RB_LOAD_RELAXED(r->tile);
+    uint16_t cnt;
+
+    cnt = r->count - (uint16_t)(tile - RB_LOAD_ACQUIRE(r->head));
+    cnt = n < cnt ? n : cnt;
+
+    if (cnt) {
+        batch_copy(r, NULL, (const uint8_t *)src, tile, cnt, true);
+        RB_STORE_RELEASE(r->tile, (uint16_t)(tile + cnt));
+    }
+
+    return cnt;
+}
+
+
+/**
+ *
+ */
+uint16_t ringbuf_elem_get_batch(__ringbuf_elem * const r, void * const dst, const uint16_t n)
+{
+    const uint16_t head = RB_LOAD_RELAXED(r->head);
+    uint16_t cnt;
+
+    cnt = (uint16_t)(RB_LOAD_ACQUIRE(r->tile) - head);
+    cnt = n < cnt ? n : cnt;
+
+    if (cnt) {
+        batch_copy(r, (uint8_t *)dst, NULL, head, cnt, false);
+        RB_STORE_RELEASE(r->head, (uint16_t)(head + cnt));
+    }
+
+    return cnt;
+}
+
+
+/**
+ * @brief Copy n elements between the ring and a linear array,
+ *        no more than two copies around the wrap point.
+ *
+ * @param r - pinter on the __ringbuf_elem
+ * @param dst - linear destination (when to_ring is false)
+ * @param src - linear source (when to_ring is true)
+ * @param idx - ring index of the first element
+ * @param n - count of elements
+ * @param to_ring - direction
+ */
+static void batch_copy(__ringbuf_elem * const r, uint8_t * dst, const uint8_t * src,
+        const uint16_t idx, const uint16_t n, const bool to_ring)
+{
+    const uint16_t pos = idx & (r->count - 1);
+    const uint16_t run = (r->count - pos) < n ? (r->count - pos) : n;
+    const uint32_t run_len = (uint32_t)run * r->elem_size;
+    const uint32_t rest_len = (uint32_t)(n - run) * r->elem_size;
+
+    if (to_ring) {
+        elem_copy(RB_ELEM_PTR(r, pos), src, run_len);
+        elem_copy(r->data, src + run_len, rest_len);
+    } else {
+        elem_copy(dst, RB_ELEM_PTR(r, pos), run_len);
+        elem_copy(dst + run_len, r->data, rest_len);
+    }
+}
+
+
+/**
+ * @brief Copy by the widest store which is allowed by alignment of
+ *        both pointers and by the length. The constant size memcpy is
+ *        compiled to one load/store and doesn't break strict aliasing.
+ *
+ * @param dst - destination
+ * @param src - source
+ * @param len - length, bytes
+ */
+static void elem_copy(void * dst, const void * src, const uint32_t len)
+{
+    const uint32_t align = (uint32_t)(uintptr_t)dst | (uint32_t)(uintptr_t)src | len;
+    uint8_t * d = (uint8_t *)dst;
+    const uint8_t * s = (const uint8_t *)src;
+    uint32_t cnt;
+
+    if (!(align & 3)) {
+        for (cnt = len >> 2; cnt; cnt--, d += 4, s += 4) {
+            __builtin_memcpy(d, s, 4);
+        }
+    } else if (!(align & 1)) {
+        for (cnt = len >> 1; cnt; cnt--, d += 2, s += 2) {
+            __builtin_memcpy(d, s, 2);
+        }
+    } else {
+        for (cnt = len; cnt; cnt--) {
+            *d++ = *s++;
+        }
+    }
+}
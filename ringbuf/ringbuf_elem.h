@@ -0,0 +1,111 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ *
+ * Ring buffer of fixed-size elements (e.g. 16/32-bit ADC samples or
+ * 12-byte event records). The element size is chosen at init time.
+ *
+ * Elements are moved by 32-bit (16-bit) stores when the element size and
+ * buffers allow it, so define the data buffer as an array of uint32_t.
+ * Lock-free single-producer/single-consumer like "init_ringbuf_spsc".
+ *
+ * For the element type fixed at compile time see "ringbuf_static.h".
+ */
+
+#ifndef __RINGBUF_ELEM_H
+#define __RINGBUF_ELEM_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#ifndef NULL
+#define NULL ((void *)0)
+#endif
+
+
+/**
+ * @brief Ring buffer of elements
+ *
+ * @field data - data buffer, count * elem_size bytes
+ * @field elem_size - size of element, bytes
+ * @field count - capacity, elements
+ * @field tile, head - free-running element indices
+ */
+typedef struct __ringbuf_elem {
+    uint8_t * data;
+    uint16_t elem_size;
+    uint16_t count;
+
+    uint16_t tile;
+    uint16_t head;
+} __ringbuf_elem;
+
+
+/**
+ * @brief Initialize new ring buffer of elements
+ *
+ * @param r - pinter on the __ringbuf_elem struct
+ * @param data - pointer on data buffer, count * elem_size bytes
+ * @param elem_size - size of element
+ * @param count - capacity in elements, power of two, no more than 32768
+ * @return false if params are wrong
+ */
+bool init_ringbuf_elem(__ringbuf_elem * const r, void * const data, const uint16_t elem_size, const uint16_t count);
+
+
+/**
+ * @brief Reset buffer. Both sides should be stopped.
+ */
+void ringbuf_elem_reset(__ringbuf_elem * const r);
+
+
+/**
+ * @brief Count of elements in buffer
+ */
+uint16_t ringbuf_elem_size(__ringbuf_elem * const r);
+
+
+/**
+ * @brief Put one element (producer side)
+ *
+ * @param r - pinter on the __ringbuf_elem struct
+ * @param elem - pointer on element
+ * @return false if buffer is full
+ */
+bool ringbuf_elem_put(__ringbuf_elem * const r, const void * const elem);
+
+
+/**
+ * @brief Get one element (consumer side)
+ *
+ * @param r - pinter on the __ringbuf_elem struct
+ * @param elem - pointer on destination
+ * @return false if buffer is empty
+ */
+bool ringbuf_elem_get(__ringbuf_elem * const r, void * const elem);
+
+
+/**
+ * @brief Put an array of elements, no more than two copies around the wrap point.
+ *
+ * @param r - pinter on the __ringbuf_elem struct
+ * @param src - pointer on array of elements
+ * @param n - count of elements
+ * @return count of elements which were put
+ */
+uint16_t ringbuf_elem_put_batch(__ringbuf_elem * const r, const void * const src, const uint16_t n);
+
+
+/**
+ * @brief Get an array of elements, no more than two copies around the wrap point.
+ *
+ * @param r - pinter on the __ringbuf_elem struct
+ * @param dst - pointer on destination array
+ * @param n - size of destination array, elements
+ * @return count of elements which were got
+ */
+uint16_t ringbuf_elem_get_batch(__ringbuf_elem * const r, void * const dst, const uint16_t n);
+
+
+#endif /* __RINGBUF_ELEM_H */
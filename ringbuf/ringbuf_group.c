@@ -0,0 +1,236 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ */
+
+
+#include "ringbuf_group.h"
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+
+/**
+ * Private macros
+ *
+ */
+#define RB_LOAD_ACQUIRE(v)         __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define RB_STORE_RELEASE(v,x)      __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#define RB_FETCH_OR(v,x)           __atomic_fetch_or(&(v), (x), __ATOMIC_ACQ_REL)
+#define RB_FETCH_AND(v,x)          __atomic_fetch_and(&(v), (x), __ATOMIC_ACQ_REL)
+#define RB_FETCH_ADD(v,x)          __atomic_fetch_add(&(v), (x), __ATOMIC_ACQ_REL)
+#define RB_FETCH_SUB(v,x)          __atomic_fetch_sub(&(v), (x), __ATOMIC_ACQ_REL)
+
+#define RB_GROUP_BIT(idx)          ((uint32_t)1 << (idx))
+
+
+static void mark_ready(__ringbuf_group * const g, const uint8_t idx, const uint16_t len);
+static void clear_ready(__ringbuf_group * const g, const uint8_t idx);
+
+
+
+/**
+ *
+ */
+void init_ringbuf_group(__ringbuf_group * const g)
+{
+    uint8_t idx;
+
+    for (idx = 0; idx < RINGBUF_GROUP_MAX; idx++) {
+        g->rings[idx] = NULL;
+    }
+
+    g->ready = 0;
+    g->pending = 0;
+    g->threshold = 0;
+    g->waiting = 0;
+}
+
+
+/**
+ *
+ */
+bool ringbuf_group_add(__ringbuf_group * const g, const uint8_t idx, __ringbuf * const r)
+{
+    if (idx >= RINGBUF_GROUP_MAX || g->rings[idx]) {
+        return false;
+    }
+
+    g->rings[idx] = r;
+
+    return true;
+}
+
+
+/**
+ *
+ */
+bool ringbuf_group_put(__ringbuf_group * const g, const uint8_t idx, const uint8_t c)
+{
+    return ringbuf_group_put_block(g, idx, &c, 1) == 1;
+}
+
+
+/**
+ *
+ */
+uint16_t ringbuf_group_put_block(__ringbuf_group * const g, const uint8_t idx, const uint8_t * const src, const uint16_t len)
+{
+    uint16_t cnt;
+
+    if (idx >= RINGBUF_GROUP_MAX || !g->rings[idx]) {
+        return 0;
+    }
+
+    cnt = ringbuf_put_block(g->rings[idx], src, len);
+
+    if (cnt) {
+        mark_ready(g, idx, cnt);
+    }
+
+    return cnt;
+}
+
+
+/**
+ *
+ */
+uint16_t ringbuf_group_get_block(__ringbuf_group * const g, const uint8_t idx, uint8_t * const dst, const uint16_t len)
+{
+    uint16_t cnt;
+
+    if (idx >= RINGBUF_GROUP_MAX || !g->rings[idx]) {
+        return 0;
+    }
+
+    cnt = ringbuf_get_block(g->rings[idx], dst, len);
+
+    /* may go below zero for a moment: the producer accounts bytes after publishing */
+    if (cnt) {
+        RB_FETCH_SUB(g->pending, (int32_t)cnt);
+    }
+
+    clear_ready(g, idx);
+
+    return cnt;
+}
+
+
+/**
+ *
+ */
+int32_t ringbuf_group_next(__ringbuf_group * const g)
+{
+    __ringbuf * r;
+    uint32_t ready;
+    uint8_t idx;
+
+    while ((ready = RB_LOAD_ACQUIRE(g->ready)) != 0) {
+        idx = (uint8_t)__builtin_ctz(ready);
+        r = g->rings[idx];
+
+        if (r->size(r)) {
+            return idx;
+        }
+
+        /* stale bit: the ring was drained before the producer has set it */
+        clear_ready(g, idx);
+    }
+
+    return -1;
+}
+
+
+/**
+ *
+ */
+uint32_t ringbuf_group_ready(__ringbuf_group * const g)
+{
+    return RB_LOAD_ACQUIRE(g->ready);
+}
+
+
+#ifdef __linux__
+
+/**
+ *
+ */
+bool ringbuf_group_wait(__ringbuf_group * const g, const uint32_t threshold, const uint32_t timeout_ms)
+{
+    const int32_t batch = threshold ? (int32_t)threshold : 1;
+    struct timespec ts;
+    int32_t pending;
+
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+    RB_STORE_RELEASE(g->threshold, batch);
+    RB_STORE_RELEASE(g->waiting, 1);
+
+    while ((pending = RB_LOAD_ACQUIRE(g->pending)) < batch) {
+        /* sleeps only if nobody has changed "pending" yet */
+        if (syscall(SYS_futex, &g->pending, FUTEX_WAIT_PRIVATE, pending,
+                timeout_ms ? &ts : NULL, NULL, 0) && errno == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    RB_STORE_RELEASE(g->waiting, 0);
+
+    return RB_LOAD_ACQUIRE(g->pending) >= batch;
+}
+
+#endif /* __linux__ */
+
+
+/**
+ * @brief Set ready bit and wake up the consumer if the batch is collected.
+ *
+ * @param g - pointer on the group
+ * @param idx - index of ring
+ * @param len - count of put bytes
+ */
+static void mark_ready(__ringbuf_group * const g, const uint8_t idx, const uint16_t len)
+{
+    int32_t pending;
+    int32_t threshold;
+
+    RB_FETCH_OR(g->ready, RB_GROUP_BIT(idx));
+    pending = RB_FETCH_ADD(g->pending, (int32_t)len) + len;
+
+#ifdef __linux__
+    threshold = (int32_t)RB_LOAD_ACQUIRE(g->threshold);
+
+    if (RB_LOAD_ACQUIRE(g->waiting) && pending >= threshold && pending - len < threshold) {
+        syscall(SYS_futex, &g->pending, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+#else
+    (void)pending;
+    (void)threshold;
+#endif
+}
+
+
+/**
+ * @brief Clear ready bit if the ring is empty.
+ *
+ * @param g - pointer on the group
+ * @param idx - index of ring
+ */
+static void clear_ready(__ringbuf_group * const g, const uint8_t idx)
+{
+    __ringbuf * const r = g->rings[idx];
+
+    if (!r->size(r)) {
+        RB_FETCH_AND(g->ready, ~RB_GROUP_BIT(idx));
+
+        /* the producer could put data between the check and the clear */
+        if (r->size(r)) {
+            RB_FETCH_OR(g->ready, RB_GROUP_BIT(idx));
+        }
+    }
+}
@@ -0,0 +1,127 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ *
+ * Readiness set for polling many ring buffers at once.
+ *
+ * The group keeps a bitmap of non-empty rings, it's updated on put and get
+ * through the group API. The consumer finds the non-empty rings by
+ * count-trailing-zeros scan instead of calling "size_ringbuf" on every ring.
+ *
+ * The rings should be in the SPSC mode with RINGBUF_REJECT_NEWEST policy.
+ * Producers (ISRs/threads) use "ringbuf_group_put*", the consumer uses
+ * "ringbuf_group_next" and "ringbuf_group_get_block".
+ *
+ * On the Linux host "ringbuf_group_wait" blocks the consumer on a futex until
+ * the count of queued bytes reaches a threshold.
+ */
+
+#ifndef __RINGBUF_GROUP_H
+#define __RINGBUF_GROUP_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ringbuf.h"
+
+
+#define RINGBUF_GROUP_MAX          32
+
+
+/**
+ * @brief Group of ring buffers
+ *
+ * @field rings - members, idx is the bit in "ready"
+ * @field ready - bitmap of non-empty rings
+ * @field pending - total count of queued bytes, it's accounted after the data is
+ *                  published, so it may be negative for a moment
+ * @field threshold - wake up threshold of the waiting consumer
+ * @field waiting - the consumer is waiting
+ */
+typedef struct __ringbuf_group {
+    __ringbuf * rings[RINGBUF_GROUP_MAX];
+
+    uint32_t ready;
+    int32_t pending;
+    uint32_t threshold;
+    uint32_t waiting;
+} __ringbuf_group;
+
+
+/**
+ * @brief Initialize empty group
+ */
+void init_ringbuf_group(__ringbuf_group * const g);
+
+
+/**
+ * @brief Add ring buffer to the group. The ring should be empty.
+ *
+ * @param g - pointer on the group
+ * @param idx - index of ring (e.g. channel number), < RINGBUF_GROUP_MAX
+ * @param r - pointer on the ring buffer
+ * @return false if idx is wrong or busy
+ */
+bool ringbuf_group_add(__ringbuf_group * const g, const uint8_t idx, __ringbuf * const r);
+
+
+/**
+ * @brief Put byte in the ring (producer side)
+ *
+ * @return false if the ring is full
+ */
+bool ringbuf_group_put(__ringbuf_group * const g, const uint8_t idx, const uint8_t c);
+
+
+/**
+ * @brief Put block in the ring (producer side)
+ *
+ * @return count of bytes which were put, 0 if idx is wrong
+ */
+uint16_t ringbuf_group_put_block(__ringbuf_group * const g, const uint8_t idx, const uint8_t * const src, const uint16_t len);
+
+
+/**
+ * @brief Get block from the ring (consumer side)
+ *
+ * @return count of bytes which were got, 0 if idx is wrong
+ */
+uint16_t ringbuf_group_get_block(__ringbuf_group * const g, const uint8_t idx, uint8_t * const dst, const uint16_t len);
+
+
+/**
+ * @brief Find the first non-empty ring, the stale ready bits are cleared (consumer side).
+ *
+ * @param g - pointer on the group
+ * @return index of ring or -1 if all rings are empty
+ */
+int32_t ringbuf_group_next(__ringbuf_group * const g);
+
+
+/**
+ * @brief Snapshot of readiness bitmap, e.g. to visit all ready rings:
+ *
+ *        for (ready = ringbuf_group_ready(g); ready; ready &= ready - 1) {
+ *            idx = __builtin_ctz(ready);
+ *            ...
+ *        }
+ */
+uint32_t ringbuf_group_ready(__ringbuf_group * const g);
+
+
+#ifdef __linux__
+
+/**
+ * @brief Block until the group has at least "threshold" queued bytes (Linux host).
+ *
+ * @param g - pointer on the group
+ * @param threshold - minimum batch, bytes (1 - wake up on any data)
+ * @param timeout_ms - timeout, 0 - infinite
+ * @return false on timeout
+ */
+bool ringbuf_group_wait(__ringbuf_group * const g, const uint32_t threshold, const uint32_t timeout_ms);
+
+#endif /* __linux__ */
+
+
+#endif /* __RINGBUF_GROUP_H */
@@ -0,0 +1,142 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ */
+
+
+#include "ringbuf_mpsc.h"
+
+#include <shared_utils.h>
+
+
+/**
+ * Private macros
+ *
+ */
+#define RB_LOAD_RELAXED(v)         __atomic_load_n(&(v), __ATOMIC_RELAXED)
+#define RB_LOAD_ACQUIRE(v)         __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define RB_STORE_RELEASE(v,x)      __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#define RB_ADD_FETCH(v,x)          __atomic_add_fetch(&(v), (x), __ATOMIC_ACQ_REL)
+#define RB_CAS(v,pexp,x)           __atomic_compare_exchange_n(&(v), (pexp), (x), \
+                                           false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+
+#define RB_MPSC_MAX_SIZE           0x4000
+
+
+static void __mpsc_reset(struct __ringbuf * const r);
+static void __mpsc_put(struct __ringbuf * const r, const uint8_t c);
+static void publish(__ringbuf_mpsc * const m, const uint16_t reserve);
+
+
+
+/**
+ *
+ */
+bool init_ringbuf_mpsc(__ringbuf_mpsc * const m, uint8_t * const data, const uint16_t size)
+{
+    if (size > RB_MPSC_MAX_SIZE || !init_ringbuf_spsc(&m->rb, data, size)) {
+        return false;
+    }
+
+    m->reserve = 0;
+    m->done = 0;
+
+    /* override producer side of interface */
+    m->rb.reset = __mpsc_reset;
+    m->rb.put = __mpsc_put;
+
+    return true;
+}
+
+
+/**
+ *
+ */
+bool ringbuf_mpsc_put_block(__ringbuf_mpsc * const m, const uint8_t * const src, const uint16_t len)
+{
+    uint16_t reserve;
+    uint16_t done;
+    uint16_t pos;
+    uint16_t run;
+
+    if (!len || len > m->rb.sz) {
+        RB_ADD_FETCH(m->rb.drops, len);
+        return false;
+    }
+
+    /* 1 - reserve space */
+    reserve = RB_LOAD_RELAXED(m->reserve);
+
+    do {
+        if ((uint16_t)(reserve - RB_LOAD_ACQUIRE(m->rb.head)) > m->rb.sz - len) {
+            RB_ADD_FETCH(m->rb.drops, len);
+            return false;
+        }
+    } while (!RB_CAS(m->reserve, &reserve, (uint16_t)(reserve + len)));
+
+    /* 2 - copy data, no more than two chunks */
+    pos = reserve & m->rb.mask;
+    run = m->rb.sz - pos;
+    run = len < run ? len : run;
+
+    mem_copy(m->rb.data + pos, src, run);
+    mem_copy(m->rb.data, src + run, len - run);
+
+    /* 3 - complete and publish if there are no outstanding reservations */
+    done = RB_ADD_FETCH(m->done, len);
+    reserve = RB_LOAD_ACQUIRE(m->reserve);
+
+    if (done == reserve) {
+        publish(m, reserve);
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Move tile forward to the reserve, it never goes back.
+ *
+ * @param m - pinter on the __ringbuf_mpsc
+ * @param reserve - completed reserve index
+ */
+static void publish(__ringbuf_mpsc * const m, const uint16_t reserve)
+{
+    uint16_t tile;
+
+    tile = RB_LOAD_RELAXED(m->rb.tile);
+
+    /* another producer could publish a newer value already */
+    while ((uint16_t)(reserve - tile) != 0 && (uint16_t)(reserve - tile) <= m->rb.sz) {
+        if (RB_CAS(m->rb.tile, &tile, reserve)) {
+            break;
+        }
+    }
+}
+
+
+/**
+ * @brief Put data byte in buf, discarded if buf is full.
+ *
+ * @param r - pinter on the __ringbuf, it's the first field of __ringbuf_mpsc
+ * @param c - data byte
+ */
+static void __mpsc_put(struct __ringbuf * const r, const uint8_t c)
+{
+    ringbuf_mpsc_put_block((__ringbuf_mpsc *)r, &c, 1);
+}
+
+
+/**
+ * @brief Reset ring buff. All producers and consumer should be stopped.
+ *
+ * @param r - pinter on the __ringbuf, it's the first field of __ringbuf_mpsc
+ */
+static void __mpsc_reset(struct __ringbuf * const r)
+{
+    __ringbuf_mpsc * const m = (__ringbuf_mpsc *)r;
+
+    RB_STORE_RELEASE(m->reserve, 0);
+    RB_STORE_RELEASE(m->done, 0);
+    RB_STORE_RELEASE(m->rb.tile, 0);
+    RB_STORE_RELEASE(m->rb.head, 0);
+}
@@ -0,0 +1,74 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ *
+ * Multi-producer/single-consumer ring buffer on top of the SPSC "__ringbuf".
+ *
+ * Several producers (e.g. two UART ISRs and a timer ISR) put blocks of data
+ * into one buffer without locks and without masking of interrupts:
+ *
+ * 1) A producer reserves space by compare-and-swap on "reserve".
+ * 2) It copies the data into the reserved space.
+ * 3) It adds the length to "done". The producer which completes the last
+ *    outstanding reservation publishes "tile" up to "reserve". So the consumer
+ *    sees the data in order of reservations and never sees a partial block.
+ *
+ * A producer never waits for other producers, so a preempted low priority
+ * ISR can't block a high priority one. The data of completed blocks becomes
+ * visible when all earlier reservations are completed too.
+ *
+ * The consumer uses the usual "__ringbuf" API with "rb" field:
+ * get_ringbuf(m.rb), size_ringbuf(m.rb), ringbuf_get_block(&m.rb, ...), ringbuf_read_peek(&m.rb, ...).
+ * Producers should use "ringbuf_mpsc_put_block" or put_ringbuf(m.rb, c) only.
+ * Only RINGBUF_REJECT_NEWEST policy is supported, rejected bytes are counted
+ * in "rb.drops".
+ */
+
+#ifndef __RINGBUF_MPSC_H
+#define __RINGBUF_MPSC_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ringbuf.h"
+
+
+/**
+ * @brief MPSC ring buffer
+ *
+ * @field rb - SPSC ring buffer, should be the first field
+ * @field reserve - free-running index of reserved space
+ * @field done - free-running count of written bytes
+ */
+typedef struct __ringbuf_mpsc {
+    __ringbuf rb;
+
+    uint16_t reserve;
+    uint16_t done;
+} __ringbuf_mpsc;
+
+
+/**
+ * @brief Initialize new multi-producer/single-consumer ring buffer.
+ *
+ * @param m - pinter on the __ringbuf_mpsc struct
+ * @param data - pointer on data buffer
+ * @param size - size of buffer, power of two, no more than 16384
+ * @return false if size is wrong
+ */
+bool init_ringbuf_mpsc(__ringbuf_mpsc * const m, uint8_t * const data, const uint16_t size);
+
+
+/**
+ * @brief Put a block of data, all or nothing. It's safe to call from several
+ *        ISRs/threads concurrently.
+ *
+ * @param m - pinter on the __ringbuf_mpsc struct
+ * @param src - pointer on data
+ * @param len - length of data
+ * @return false if there is no space for the whole block
+ */
+bool ringbuf_mpsc_put_block(__ringbuf_mpsc * const m, const uint8_t * const src, const uint16_t len);
+
+
+#endif /* __RINGBUF_MPSC_H */
@@ -0,0 +1,139 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ *
+ * Header-only ring buffer with the element type and the capacity fixed
+ * at compile time.
+ *
+ * All functions are "static inline", there is no interface pointers in the
+ * structure, the index mask is a constant. So the compiler is able to inline
+ * put/get into the caller. The buffer is lock-free single-producer/single-consumer
+ * like "init_ringbuf_spsc" one.
+ *
+ * How to use:
+ *
+ *   RINGBUF_STATIC_DEFINE(uart_rx, uint8_t, 64)
+ *
+ *   static __uart_rx rx;     (zero-initialized static is empty buffer)
+ *
+ *   uart_rx_put(&rx, byte);  (in ISR)
+ *   uart_rx_get(&rx, &byte); (in main loop)
+ *
+ * The legacy "__ringbuf" and "init_ringbuf" from "ringbuf.h" are not affected.
+ */
+
+#ifndef __RINGBUF_STATIC_H
+#define __RINGBUF_STATIC_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**
+ * @brief Generates a ring buffer type "__name" and its API:
+ *
+ *        void name_reset(__name * const r);
+ *        uint16_t name_size(__name * const r);
+ *        bool name_put(__name * const r, const type v);   false if full
+ *        bool name_get(__name * const r, type * const v); false if empty
+ *        uint16_t name_put_n(__name * const r, const type * const src, const uint16_t n);
+ *        uint16_t name_get_n(__name * const r, type * const dst, const uint16_t n);
+ *
+ *        Batch functions return the count of moved elements.
+ *
+ * @param name - prefix of the type and the functions
+ * @param type - element type
+ * @param size - capacity, power of two, no more than 32768
+ */
+#define RINGBUF_STATIC_DEFINE(name,type,size)                                         \
+                                                                                      \
+typedef char name##_size_should_be_power_of_two                                       \
+        [((size) && !((size) & ((size) - 1)) && (size) <= 0x8000) ? 1 : -1];          \
+                                                                                      \
+typedef struct __##name {                                                             \
+    uint16_t tile;                                                                    \
+    uint16_t head;                                                                    \
+    type data[(size)];                                                                \
+} __##name;                                                                           \
+                                                                                      \
+static inline void name##_reset(__##name * const r)                                   \
+{                                                                                     \
+    __atomic_store_n(&r->tile, 0, __ATOMIC_RELEASE);                                  \
+    __atomic_store_n(&r->head, 0, __ATOMIC_RELEASE);                                  \
+}                                                                                     \
+                                                                                      \
+static inline uint16_t name##_size(__##name * const r)                                \
+{                                                                                     \
+    const uint16_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);                \
+                                                                                      \
+    return (uint16_t)(__atomic_load_n(&r->tile, __ATOMIC_ACQUIRE) - head);            \
+}                                                                                     \
+                                                                                      \
+static inline bool name##_put(__##name * const r, const type v)                       \
+{                                                                                     \
+    const uint16_t tile = __atomic_load_n(&r->tile, __ATOMIC_RELAXED);                \
+                                                                                      \
+    if ((uint16_t)(tile - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)) >= (size)) {   \
+        return false;                                                                 \
+    }                                                                                 \
+                                                                                      \
+    r->data[tile & ((size) - 1)] = v;                                                 \
+    __atomic_store_n(&r->tile, (uint16_t)(tile + 1), __ATOMIC_RELEASE);               \
+                                                                                      \
+    return true;                                                                      \
+}                                                                                     \
+                                                                                      \
+static inline bool name##_get(__##name * const r, type * const v)                     \
+{                                                                                     \
+    const uint16_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);                \
+                                                                                      \
+    if (__atomic_load_n(&r->tile, __ATOMIC_ACQUIRE) == head) {                        \
+        return false;                                                                 \
+    }                                                                                 \
+                                                                                      \
+    *v = r->data[head & ((size) - 1)];                                                \
+    __atomic_store_n(&r->head, (uint16_t)(head + 1), __ATOMIC_RELEASE);               \
+                                                                                      \
+    return true;                                                                      \
+}                                                                                     \
+                                                                                      \
+static inline uint16_t name##_put_n(__##name * const r, const type * const src,       \
+        const uint16_t n)                                                             \
+{                                                                                     \
+    const uint16_t tile = __atomic_load_n(&r->tile, __ATOMIC_RELAXED);                \
+    uint16_t cnt;                                                                     \
+    uint16_t i;                                                                       \
+                                                                                      \
+    cnt = (size) - (uint16_t)(tile - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE));    \
+    cnt = n < cnt ? n : cnt;                                                          \
+                                                                                      \
+    for (i = 0; i < cnt; i++) {                                                       \
+        r->data[(uint16_t)(tile + i) & ((size) - 1)] = src[i];                        \
+    }                                                                                 \
+                                                                                      \
+    __atomic_store_n(&r->tile, (uint16_t)(tile + cnt), __ATOMIC_RELEASE);             \
+                                                                                      \
+    return cnt;                                                                       \
+}                                                                                     \
+                                                                                      \
+static inline uint16_t name##_get_n(__##name * const r, type * const dst,             \
+        const uint16_t n)                                                             \
+{                                                                                     \
+    const uint16_t head = __atomic_load_n(&r->head, __ATOMIC_RELAXED);                \
+    uint16_t cnt;                                                                     \
+    uint16_t i;                                                                       \
+                                                                                      \
+    cnt = (uint16_t)(__atomic_load_n(&r->tile, __ATOMIC_ACQUIRE) - head);             \
+    cnt = n < cnt ? n : cnt;                                                          \
+                                                                                      \
+    for (i = 0; i < cnt; i++) {                                                       \
+        dst[i] = r->data[(uint16_t)(head + i) & ((size) - 1)];                        \
+    }                                                                                 \
+                                                                                      \
+    __atomic_store_n(&r->head, (uint16_t)(head + cnt), __ATOMIC_RELEASE);             \
+                                                                                      \
+    return cnt;                                                                       \
+}
+
+
+#endif /* __RINGBUF_STATIC_H */
@@ -0,0 +1,896 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ */
+
+
+
+#include "ringbuf.h"
+#include "ringbuf_static.h"
+#include "ringbuf_mpsc.h"
+#include "ringbuf_elem.h"
+#include "ringbuf_group.h"
+
+#include <v_printf.h>
+#include <shared_utils.h>
+
+#ifdef RINGBUF_HOST_TESTS
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+static void assert(bool value, const char *error) {
+    if (!value) {
+        v_printf("Assert error:%s\r\n", error);
+
+        while(1);
+    }
+}
+
+
+
+#define RINGBUF_TEST_SIZE         8
+#define RINGBUF_STRESS_SIZE       64
+#define RINGBUF_STRESS_COUNT      1000000
+#define RINGBUF_MPSC_PRODUCERS    8
+#define RINGBUF_MPSC_RECORD       4
+
+#define PRINT_TEST_NAME(s)        v_printf(#s, 1)
+
+
+RINGBUF_STATIC_DEFINE(test_samples, uint16_t, RINGBUF_TEST_SIZE)
+
+
+
+static void ringbuf_legacy_test(void);
+static void ringbuf_spsc_init_test(void);
+static void ringbuf_spsc_put_get_test(void);
+static void ringbuf_spsc_wrap_test(void);
+static void ringbuf_block_test(void);
+static void ringbuf_legacy_block_test(void);
+static void ringbuf_zero_copy_test(void);
+static void ringbuf_static_test(void);
+static void ringbuf_mpsc_test(void);
+static void ringbuf_policy_test(void);
+static void ringbuf_legacy_policy_test(void);
+static void ringbuf_elem_test(void);
+static void ringbuf_static_batch_test(void);
+static void ringbuf_group_test(void);
+
+#ifdef QSTAT_EN
+static void ringbuf_stats_test(void);
+#endif
+
+#ifdef RINGBUF_HOST_TESTS
+static void ringbuf_spsc_stress_test(void);
+static void ringbuf_mpsc_stress_test(void);
+static void ringbuf_group_wait_test(void);
+#endif
+
+
+/**
+ *
+ */
+void ringbuf_run_tests(void)
+{
+    /*******/
+    ringbuf_legacy_test();
+
+    /*******/
+    ringbuf_spsc_init_test();
+
+    /*******/
+    ringbuf_spsc_put_get_test();
+
+    /*******/
+    ringbuf_spsc_wrap_test();
+
+    /*******/
+    ringbuf_block_test();
+
+    /*******/
+    ringbuf_legacy_block_test();
+
+    /*******/
+    ringbuf_zero_copy_test();
+
+    /*******/
+    ringbuf_static_test();
+
+    /*******/
+    ringbuf_mpsc_test();
+
+    /*******/
+    ringbuf_policy_test();
+
+    /*******/
+    ringbuf_legacy_policy_test();
+
+    /*******/
+    ringbuf_elem_test();
+
+    /*******/
+    ringbuf_static_batch_test();
+
+    /*******/
+    ringbuf_group_test();
+
+#ifdef QSTAT_EN
+    /*******/
+    ringbuf_stats_test();
+#endif
+
+#ifdef RINGBUF_HOST_TESTS
+    /*******/
+    ringbuf_spsc_stress_test();
+
+    /*******/
+    ringbuf_mpsc_stress_test();
+
+    /*******/
+    ringbuf_group_wait_test();
+#endif
+
+    v_printf("Ringbuf tests have finished successfully\r\n", 1);
+}
+
+
+/**
+ *
+ */
+static void ringbuf_legacy_test(void)
+{
+    uint8_t heap[RINGBUF_TEST_SIZE];
+    __ringbuf rb;
+
+    PRINT_TEST_NAME(ringbuf_legacy_test\r\n);
+
+    init_ringbuf(&rb, heap, RINGBUF_TEST_SIZE);
+
+    assert(size_ringbuf(rb) == 0, "Should be empty");
+
+    put_ringbuf(rb, 'A');
+    put_ringbuf(rb, 'T');
+
+    assert(size_ringbuf(rb) == 2, "Should be 2");
+    assert(get_ringbuf(rb) == 'A', "Should be A");
+    assert(get_ringbuf(rb) == 'T', "Should be T");
+    assert(size_ringbuf(rb) == 0, "Should be empty");
+}
+
+
+/**
+ *
+ */
+static void ringbuf_spsc_init_test(void)
+{
+    uint8_t heap[RINGBUF_TEST_SIZE];
+    __ringbuf rb;
+
+    PRINT_TEST_NAME(ringbuf_spsc_init_test\r\n);
+
+    assert(!init_ringbuf_spsc(&rb, heap, 0), "Zero size should be rejected");
+    assert(!init_ringbuf_spsc(&rb, heap, 1), "Size 1 should be rejected");
+    assert(!init_ringbuf_spsc(&rb, heap, RINGBUF_TEST_SIZE - 1), "Size should be a power of two");
+    assert(init_ringbuf_spsc(&rb, heap, RINGBUF_TEST_SIZE), "Size is a power of two");
+    assert(size_ringbuf(rb) == 0, "Should be empty");
+}
+
+
+/**
+ *
+ */
+static void ringbuf_spsc_put_get_test(void)
+{
+    uint8_t heap[RINGBUF_TEST_SIZE];
+    __ringbuf rb;
+    uint8_t i;
+
+    PRINT_TEST_NAME(ringbuf_spsc_put_get_test\r\n);
+
+    init_ringbuf_spsc(&rb, heap, RINGBUF_TEST_SIZE);
+
+    /* all slots are usable */
+    for (i = 0; i < RINGBUF_TEST_SIZE; i++) {
+        put_ringbuf(rb, '0' + i);
+    }
+
+    assert(size_ringbuf(rb) == RINGBUF_TEST_SIZE, "Should be full");
+
+    /* buf is full and should discard a byte */
+    put_ringbuf(rb, 'X');
+
+    assert(size_ringbuf(rb) == RINGBUF_TEST_SIZE, "Should be full");
+
+    for (i = 0; i < RINGBUF_TEST_SIZE; i++) {
+        assert(get_ringbuf(rb) == '0' + i, "Wrong order");
+    }
+
+    assert(size_ringbuf(rb) == 0, "Should be empty");
+    assert(get_ringbuf(rb) == 0, "Empty get should return 0");
+}
+
+
+/**
+ *
+ */
+static void ringbuf_spsc_wrap_test(void)
+{
+    uint8_t heap[RINGBUF_TEST_SIZE];
+    __ringbuf rb;
+    uint32_t i;
+
+    PRINT_TEST_NAME(ringbuf_spsc_wrap_test\r\n);
+
+    init_ringbuf_spsc(&rb, heap, RINGBUF_TEST_SIZE);
+
+    /* run indices over the uint16_t overflow */
+    for (i = 0; i < 0x10000 + 3; i++) {
+        put_ringbuf(rb, (uint8_t)i);
+        put_ringbuf(rb, (uint8_t)(i + 1));
+
+        assert(size_ringbuf(rb) == 2, "Should be 2");
+        assert(get_ringbuf(rb) == (uint8_t)i, "Wrong first byte");
+        assert(get_ringbuf(rb) == (uint8_t)(i + 1), "Wrong second byte");
+    }
+}
+
+
+/**
+ *
+ */
+static void ringbuf_block_test(void)
+{
+    uint8_t heap[RINGBUF_TEST_SIZE];
+    uint8_t buf[RINGBUF_TEST_SIZE + 1];
+    __ringbuf rb;
+    uint16_t len;
+
+    PRINT_TEST_NAME(ringbuf_block_test\r\n);
+
+    init_ringbuf_spsc(&rb, heap, RINGBUF_TEST_SIZE);
+
+    len = put_block_ringbuf(rb, (const uint8_t *)"test1", 5);
+    assert(len == 5, "Should be 5");
+
+    len = get_block_ringbuf(rb, buf, 3);
+    assert(len == 3 && mem_cmp(buf, "tes", 3), "Get block is worked wrong");
+
+    /* wraps around the end, only 6 bytes are free */
+    len = put_block_ringbuf(rb, (const uint8_t *)"12345678", 8);
+    assert(len == 6, "Should be 6");
+    assert(size_ringbuf(rb) == RINGBUF_TEST_SIZE, "Should be full");
+
+    len = put_block_ringbuf(rb, (const uint8_t *)"9", 1);
+    assert(len == 0, "Should be 0");
+
+    len = get_block_ringbuf(rb, buf, sizeof(buf));
+    assert(len == RINGBUF_TEST_SIZE && mem_cmp(buf, "t1123456", len), "Wrapped get block is worked wrong");
+
+    len = get_block_ringbuf(rb, buf, sizeof(buf));
+    assert(len == 0, "Should be empty");
+}
+
+
+/**
+ *
+ */
+static void ringbuf_legacy_block_test(void)
+{
+    uint8_t heap[RINGBUF_TEST_SIZE];
+    uint8_t buf[RINGBUF_TEST_SIZE];
+    __ringbuf rb;
+    uint16_t len;
+
+    PRINT_TEST_NAME(ringbuf_legacy_block_test\r\n);
+
+    init_ringbuf(&rb, heap, RINGBUF_TEST_SIZE);
+
+    len = put_block_ringbuf(rb, (const uint8_t *)"test1", 5);
+    assert(len == 5, "Should be 5");
+
+    len = get_block_ringbuf(rb, buf, 3);
+    assert(len == 3 && mem_cmp(buf, "tes", 3), "Get block is worked wrong");
+
+    /* legacy mode keeps one slot free, only 5 bytes are free */
+    len = put_block_ringbuf(rb, (const uint8_t *)"12345678", 8);
+    assert(len == 5, "Should be 5");
+    assert(size_ringbuf(rb) == RINGBUF_TEST_SIZE - 1, "Should be full");
+
+    /* mixed byte and block access */
+    assert(get_ringbuf(rb) == 't', "Should be t");
+
+    len = get_block_ringbuf(rb, buf, sizeof(buf));
+    assert(len == 6 && mem_cmp(buf, "112345", len), "Wrapped get block is worked wrong");
+    assert(size_ringbuf(rb) == 0, "Should be empty");
+}
+
+
+/**
+ *
+ */
+static void ringbuf_zero_copy_test(void)
+{
+    uint8_t heap[RINGBUF_TEST_SIZE];
+    __ringbuf rb;
+    uint8_t * wr;
+    const uint8_t * rd;
+    uint16_t len;
+
+    PRINT_TEST_NAME(ringbuf_zero_copy_test\r\n);
+
+    init_ringbuf_spsc(&rb, heap, RINGBUF_TEST_SIZE);
+
+    len = write_acquire_ringbuf(rb, &wr);
+    assert(len == RINGBUF_TEST_SIZE && wr == heap, "Whole buf should be free");
+
+    /* DMA has received 6 bytes */
+    mem_copy(wr, "abcdef", 6);
+    assert(!write_commit_ringbuf(rb, RINGBUF_TEST_SIZE + 1), "Commit more than region");
+    assert(write_commit_ringbuf(rb, 6), "Commit should be OK");
+
+    len = read_peek_ringbuf(rb, &rd);
+    assert(len == 6 && rd == heap && mem_cmp(rd, "abcdef", 6), "Peek is worked wrong");
+    assert(read_release_ringbuf(rb, 5), "Release should be OK");
+
+    /* region ends at the wrap point */
+    len = write_acquire_ringbuf(rb, &wr);
+    assert(len == 2 && wr == heap + 6, "Region should end at the wrap point");
+    mem_copy(wr, "gh", 2);
+    write_commit_ringbuf(rb, 2);
+
+    len = write_acquire_ringbuf(rb, &wr);
+    assert(len == 5 && wr == heap, "Region should start from 0");
+    mem_copy(wr, "ij", 2);
+    write_commit_ringbuf(rb, 2);
+
+    len = read_peek_ringbuf(rb, &rd);
+    assert(len == 3 && mem_cmp(rd, "fgh", 3), "Peek before the wrap point");
+    read_release_ringbuf(rb, len);
+
+    len = read_peek_ringbuf(rb, &rd);
+    assert(len == 2 && mem_cmp(rd, "ij", 2), "Peek after the wrap point");
+    read_release_ringbuf(rb, len);
+
+    len = read_peek_ringbuf(rb, &rd);
+    assert(len == 0 && rd == NULL, "Should be empty");
+}
+
+
+/**
+ *
+ */
+static void ringbuf_static_test(void)
+{
+    __test_samples rb;
+    uint16_t sample;
+    uint16_t i;
+
+    PRINT_TEST_NAME(ringbuf_static_test\r\n);
+
+    test_samples_reset(&rb);
+
+    assert(test_samples_size(&rb) == 0, "Should be empty");
+    assert(!test_samples_get(&rb, &sample), "Get from empty should fail");
+
+    for (i = 0; i < RINGBUF_TEST_SIZE; i++) {
+        assert(test_samples_put(&rb, 0x1000 + i), "Put should be OK");
+    }
+
+    assert(!test_samples_put(&rb, 0xffff), "Put into full should fail");
+    assert(test_samples_size(&rb) == RINGBUF_TEST_SIZE, "Should be full");
+
+    for (i = 0; i < RINGBUF_TEST_SIZE; i++) {
+        assert(test_samples_get(&rb, &sample) && sample == 0x1000 + i, "Wrong sample");
+    }
+
+    assert(test_samples_size(&rb) == 0, "Should be empty");
+}
+
+
+/**
+ *
+ */
+static void ringbuf_mpsc_test(void)
+{
+    uint8_t heap[RINGBUF_TEST_SIZE];
+    uint8_t buf[RINGBUF_TEST_SIZE];
+    __ringbuf_mpsc m;
+    uint16_t len;
+
+    PRINT_TEST_NAME(ringbuf_mpsc_test\r\n);
+
+    assert(!init_ringbuf_mpsc(&m, heap, RINGBUF_TEST_SIZE - 1), "Size should be a power of two");
+    assert(init_ringbuf_mpsc(&m, heap, RINGBUF_TEST_SIZE), "Size is a power of two");
+
+    assert(ringbuf_mpsc_put_block(&m, (const uint8_t *)"abc", 3), "Put should be OK");
+    put_ringbuf(m.rb, 'd');
+    assert(ringbuf_mpsc_put_block(&m, (const uint8_t *)"efg", 3), "Put should be OK");
+
+    /* all or nothing */
+    assert(!ringbuf_mpsc_put_block(&m, (const uint8_t *)"hij", 3), "No space for the block");
+    assert(size_ringbuf(m.rb) == 7, "Should be 7");
+
+    len = ringbuf_get_block(&m.rb, buf, 5);
+    assert(len == 5 && mem_cmp(buf, "abcde", 5), "Get block is worked wrong");
+
+    /* wraps around the end */
+    assert(ringbuf_mpsc_put_block(&m, (const uint8_t *)"hijkl", 5), "Put should be OK");
+
+    len = ringbuf_get_block(&m.rb, buf, sizeof(buf));
+    assert(len == 7 && mem_cmp(buf, "fghijkl", 7), "Wrapped get block is worked wrong");
+
+    reset_ringbuf(m.rb);
+    assert(size_ringbuf(m.rb) == 0 && m.reserve == 0, "Should be empty");
+}
+
+
+/**
+ *
+ */
+static void ringbuf_policy_test(void)
+{
+    uint8_t heap[RINGBUF_TEST_SIZE];
+    uint8_t buf[RINGBUF_TEST_SIZE];
+    __ringbuf rb;
+    uint16_t len;
+
+    PRINT_TEST_NAME(ringbuf_policy_test\r\n);
+
+    init_ringbuf_spsc(&rb, heap, RINGBUF_TEST_SIZE);
+
+    /* reject newest */
+    len = put_block_ringbuf(rb, (const uint8_t *)"0123456789", 10);
+    assert(len == RINGBUF_TEST_SIZE && ringbuf_get_drops(&rb) == 2, "2 bytes should be rejected");
+
+    put_ringbuf(rb, 'X');
+    assert(ringbuf_get_drops(&rb) == 3, "1 byte should be rejected");
+    assert(get_ringbuf(rb) == '0', "Oldest byte should be kept");
+
+    /* overwrite oldest */
+    ringbuf_set_policy(&rb, RINGBUF_OVERWRITE_OLDEST);
+
+    put_ringbuf(rb, 'a');
+    put_ringbuf(rb, 'b');
+    assert(ringbuf_get_drops(&rb) == 4, "1 byte should be overwritten");
+    assert(size_ringbuf(rb) == RINGBUF_TEST_SIZE, "Should be full");
+    assert(get_ringbuf(rb) == '2', "Oldest byte should be dropped");
+
+    len = put_block_ringbuf(rb, (const uint8_t *)"cde", 3);
+    assert(len == 3 && ringbuf_get_drops(&rb) == 6, "2 bytes should be overwritten");
+
+    len = get_block_ringbuf(rb, buf, sizeof(buf));
+    assert(len == RINGBUF_TEST_SIZE && mem_cmp(buf, "567abcde", len), "Newest bytes should be kept");
+
+    /* block is longer than buf, only its tail survives */
+    len = put_block_ringbuf(rb, (const uint8_t *)"0123456789", 10);
+    assert(len == RINGBUF_TEST_SIZE && ringbuf_get_drops(&rb) == 8, "2 bytes should be dropped");
+
+    len = get_block_ringbuf(rb, buf, sizeof(buf));
+    assert(len == RINGBUF_TEST_SIZE && mem_cmp(buf, "23456789", len), "Tail of block should be kept");
+}
+
+
+/**
+ *
+ */
+static void ringbuf_legacy_policy_test(void)
+{
+    uint8_t heap[RINGBUF_TEST_SIZE];
+    uint8_t buf[RINGBUF_TEST_SIZE];
+    __ringbuf rb;
+    uint16_t len;
+    uint8_t i;
+
+    PRINT_TEST_NAME(ringbuf_legacy_policy_test\r\n);
+
+    init_ringbuf(&rb, heap, RINGBUF_TEST_SIZE);
+
+    for (i = 0; i < RINGBUF_TEST_SIZE; i++) {
+        put_ringbuf(rb, '0' + i);
+    }
+
+    assert(ringbuf_get_drops(&rb) == 1, "Newest byte should be rejected");
+
+    len = get_block_ringbuf(rb, buf, sizeof(buf));
+    assert(len == RINGBUF_TEST_SIZE - 1 && mem_cmp(buf, "0123456", len), "Newest byte should be rejected");
+
+    ringbuf_set_policy(&rb, RINGBUF_OVERWRITE_OLDEST);
+
+    for (i = 0; i < RINGBUF_TEST_SIZE + 2; i++) {
+        put_ringbuf(rb, 'a' + i);
+    }
+
+    assert(ringbuf_get_drops(&rb) == 4, "3 bytes should be overwritten");
+
+    len = put_block_ringbuf(rb, (const uint8_t *)"XY", 2);
+    assert(len == 2 && ringbuf_get_drops(&rb) == 6, "2 bytes should be overwritten");
+
+    len = get_block_ringbuf(rb, buf, sizeof(buf));
+    assert(len == RINGBUF_TEST_SIZE - 1 && mem_cmp(buf, "fghijXY", len), "Oldest bytes should be dropped");
+}
+
+
+/**
+ *
+ */
+static void ringbuf_elem_test(void)
+{
+    uint32_t heap[RINGBUF_TEST_SIZE * 3];
+    uint32_t records[RINGBUF_TEST_SIZE + 2][3];
+    uint32_t record[3];
+    __ringbuf_elem rb;
+    uint16_t len;
+    uint16_t i;
+
+    PRINT_TEST_NAME(ringbuf_elem_test\r\n);
+
+    assert(!init_ringbuf_elem(&rb, heap, 12, RINGBUF_TEST_SIZE - 1), "Count should be a power of two");
+    assert(init_ringbuf_elem(&rb, heap, 12, RINGBUF_TEST_SIZE), "Params are OK");
+
+    for (i = 0; i < RINGBUF_TEST_SIZE + 2; i++) {
+        records[i][0] = i;
+        records[i][1] = 0x1000 + i;
+        records[i][2] = 0x2000 + i;
+    }
+
+    assert(ringbuf_elem_put(&rb, records[0]), "Put should be OK");
+    assert(ringbuf_elem_put_batch(&rb, records[1], 4) == 4, "Should be 4");
+    assert(ringbuf_elem_size(&rb) == 5, "Should be 5");
+
+    assert(ringbuf_elem_get(&rb, record) && mem_cmp(record, records[0], 12), "Get is worked wrong");
+    assert(ringbuf_elem_get_batch(&rb, records[RINGBUF_TEST_SIZE], 2) == 2, "Should be 2");
+    assert(records[RINGBUF_TEST_SIZE][1] == 0x1001 && records[RINGBUF_TEST_SIZE + 1][2] == 0x2002,
+            "Get batch is worked wrong");
+
+    /* wraps around the end, only 6 records are free */
+    len = ringbuf_elem_put_batch(&rb, records[0], RINGBUF_TEST_SIZE);
+    assert(len == 6 && ringbuf_elem_size(&rb) == RINGBUF_TEST_SIZE, "Should be full");
+    assert(!ringbuf_elem_put(&rb, records[0]), "Put into full should fail");
+
+    ringbuf_elem_get_batch(&rb, record, 1);
+    ringbuf_elem_get_batch(&rb, record, 1);
+    assert(record[0] == 4, "Should be record 4");
+
+    for (i = 0; i < 6; i++) {
+        assert(ringbuf_elem_get(&rb, record) && record[2] == 0x2000u + i, "Wrapped get is worked wrong");
+    }
+
+    assert(!ringbuf_elem_get(&rb, record), "Get from empty should fail");
+}
+
+
+/**
+ *
+ */
+static void ringbuf_static_batch_test(void)
+{
+    __test_samples rb;
+    uint16_t samples[RINGBUF_TEST_SIZE] = {1, 2, 3, 4, 5, 6, 7, 8};
+    uint16_t out[RINGBUF_TEST_SIZE];
+
+    PRINT_TEST_NAME(ringbuf_static_batch_test\r\n);
+
+    test_samples_reset(&rb);
+
+    assert(test_samples_put_n(&rb, samples, 5) == 5, "Should be 5");
+    assert(test_samples_get_n(&rb, out, 3) == 3 && out[2] == 3, "Should be 3");
+    assert(test_samples_put_n(&rb, samples, RINGBUF_TEST_SIZE) == 6, "Should be 6");
+    assert(test_samples_get_n(&rb, out, RINGBUF_TEST_SIZE) == RINGBUF_TEST_SIZE, "Should be full");
+    assert(out[0] == 4 && out[1] == 5 && out[2] == 1 && out[7] == 6, "Wrapped batch is worked wrong");
+}
+
+
+/**
+ *
+ */
+static void ringbuf_group_test(void)
+{
+    uint8_t heap[3][RINGBUF_TEST_SIZE];
+    uint8_t buf[RINGBUF_TEST_SIZE];
+    __ringbuf rb[3];
+    __ringbuf_group g;
+    uint32_t ready;
+
+    PRINT_TEST_NAME(ringbuf_group_test\r\n);
+
+    init_ringbuf_group(&g);
+
+    init_ringbuf_spsc(&rb[0], heap[0], RINGBUF_TEST_SIZE);
+    init_ringbuf_spsc(&rb[1], heap[1], RINGBUF_TEST_SIZE);
+    init_ringbuf_spsc(&rb[2], heap[2], RINGBUF_TEST_SIZE);
+
+    assert(ringbuf_group_add(&g, 3, &rb[0]), "Add should be OK");
+    assert(ringbuf_group_add(&g, 7, &rb[1]), "Add should be OK");
+    assert(ringbuf_group_add(&g, 31, &rb[2]), "Add should be OK");
+    assert(!ringbuf_group_add(&g, 7, &rb[2]), "Index is busy");
+    assert(!ringbuf_group_add(&g, RINGBUF_GROUP_MAX, &rb[2]), "Index is wrong");
+
+    assert(ringbuf_group_next(&g) == -1, "All rings should be empty");
+
+    ringbuf_group_put_block(&g, 31, (const uint8_t *)"ab", 2);
+    ringbuf_group_put(&g, 7, 'c');
+
+    ready = ringbuf_group_ready(&g);
+    assert(ready == (((uint32_t)1 << 31) | (1 << 7)), "Wrong bitmap");
+    assert(ringbuf_group_next(&g) == 7, "Ring 7 should be first");
+    assert(g.pending == 3, "Should be 3");
+
+    assert(ringbuf_group_get_block(&g, 7, buf, sizeof(buf)) == 1 && buf[0] == 'c', "Wrong data");
+    assert(ringbuf_group_next(&g) == 31, "Ring 31 should be next");
+
+    /* partial get keeps the ring ready */
+    assert(ringbuf_group_get_block(&g, 31, buf, 1) == 1 && buf[0] == 'a', "Wrong data");
+    assert(ringbuf_group_next(&g) == 31, "Ring 31 should be ready");
+
+    ringbuf_group_get_block(&g, 31, buf, sizeof(buf));
+    assert(ringbuf_group_next(&g) == -1 && g.pending == 0, "All rings should be empty");
+
+    assert(ringbuf_group_put(&g, 5, 'd') == false, "Ring 5 isn't added");
+    assert(ringbuf_group_get_block(&g, RINGBUF_GROUP_MAX, buf, 1) == 0, "Index is wrong");
+
+    /* the producer has set the bit after the consumer drained the ring */
+    g.ready |= 1 << 3;
+    assert(ringbuf_group_next(&g) == -1 && ringbuf_group_ready(&g) == 0, "Stale bit should be cleared");
+}
+
+
+#ifdef QSTAT_EN
+
+static uint32_t test_ticks;
+
+static uint32_t test_timestamp(void)
+{
+    return test_ticks;
+}
+
+
+/**
+ *
+ */
+static void ringbuf_stats_test(void)
+{
+    uint8_t heap[RINGBUF_TEST_SIZE];
+    uint8_t buf[RINGBUF_TEST_SIZE];
+    __ringbuf rb;
+
+    PRINT_TEST_NAME(ringbuf_stats_test\r\n);
+
+    init_ringbuf_spsc(&rb, heap, RINGBUF_TEST_SIZE);
+
+    test_ticks = 0;
+    qstat_set_timestamp(test_timestamp);
+
+    /* the first byte of the block is sampled */
+    put_block_ringbuf(rb, (const uint8_t *)"abcdef", 6);
+    assert(rb.stats.bytes_in == 6 && rb.stats.peak == 6, "Wrong push stats");
+
+    test_ticks = 5;
+    get_block_ringbuf(rb, buf, 2);
+    assert(rb.stats.bytes_out == 2, "Wrong pop stats");
+    assert(rb.stats.hist[2] == 1, "Residency 5 should be in bin 2");
+
+    /* only 4 bytes fit */
+    put_block_ringbuf(rb, (const uint8_t *)"01234567", 8);
+    assert(rb.stats.overflows == 1 && rb.stats.peak == RINGBUF_TEST_SIZE, "Wrong overflow stats");
+
+    get_block_ringbuf(rb, buf, sizeof(buf));
+    assert(rb.stats.bytes_out == 10 && rb.stats.hist[0] == 1, "Wrong pop stats");
+
+    get_ringbuf(rb);
+    get_block_ringbuf(rb, buf, sizeof(buf));
+    assert(rb.stats.underflows == 2, "Should be 2");
+
+    qstat_dump(&rb.stats, "rb");
+
+    qstat_set_timestamp(NULL);
+}
+
+#endif /* QSTAT_EN */
+
+
+#ifdef RINGBUF_HOST_TESTS
+
+/**
+ * @brief Producer thread, it pushes the counter sequence.
+ */
+static void * spsc_producer(void * arg)
+{
+    __ringbuf * const rb = (__ringbuf *)arg;
+    uint32_t i;
+
+    for (i = 0; i < RINGBUF_STRESS_COUNT; ) {
+        if (rb->size(rb) < rb->sz) {
+            rb->put(rb, (uint8_t)i++);
+        } else {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ *
+ */
+static void ringbuf_spsc_stress_test(void)
+{
+    uint8_t heap[RINGBUF_STRESS_SIZE];
+    __ringbuf rb;
+    pthread_t producer;
+    uint32_t i;
+
+    PRINT_TEST_NAME(ringbuf_spsc_stress_test\r\n);
+
+    init_ringbuf_spsc(&rb, heap, RINGBUF_STRESS_SIZE);
+
+    pthread_create(&producer, NULL, spsc_producer, &rb);
+
+    for (i = 0; i < RINGBUF_STRESS_COUNT; ) {
+        if (size_ringbuf(rb)) {
+            assert(get_ringbuf(rb) == (uint8_t)i++, "Sequence is broken");
+        } else {
+            sched_yield();
+        }
+    }
+
+    pthread_join(producer, NULL);
+
+    assert(size_ringbuf(rb) == 0, "Should be empty");
+}
+
+/**
+ * @brief MPSC producer thread params
+ */
+typedef struct {
+    __ringbuf_mpsc * m;
+    uint8_t id;
+} __mpsc_producer_arg;
+
+
+/**
+ * @brief MPSC producer thread, it pushes records {id, seq0, seq1, seq2}.
+ */
+static void * mpsc_producer(void * arg)
+{
+    __ringbuf_mpsc * const m = ((__mpsc_producer_arg *)arg)->m;
+    uint8_t record[RINGBUF_MPSC_RECORD];
+    uint32_t seq;
+
+    record[0] = ((__mpsc_producer_arg *)arg)->id;
+
+    for (seq = 0; seq < RINGBUF_STRESS_COUNT / RINGBUF_MPSC_PRODUCERS; ) {
+        record[1] = (uint8_t)seq;
+        record[2] = (uint8_t)(seq >> 8);
+        record[3] = (uint8_t)(seq >> 16);
+
+        if (ringbuf_mpsc_put_block(m, record, RINGBUF_MPSC_RECORD)) {
+            seq++;
+        } else {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ *
+ */
+static void ringbuf_mpsc_stress_test(void)
+{
+    uint8_t heap[RINGBUF_STRESS_SIZE];
+    __ringbuf_mpsc m;
+    pthread_t producers[RINGBUF_MPSC_PRODUCERS];
+    __mpsc_producer_arg args[RINGBUF_MPSC_PRODUCERS];
+    uint32_t expected[RINGBUF_MPSC_PRODUCERS];
+    uint8_t record[RINGBUF_MPSC_RECORD];
+    uint32_t seq;
+    uint32_t i;
+
+    PRINT_TEST_NAME(ringbuf_mpsc_stress_test\r\n);
+
+    init_ringbuf_mpsc(&m, heap, RINGBUF_STRESS_SIZE);
+
+    for (i = 0; i < RINGBUF_MPSC_PRODUCERS; i++) {
+        args[i].m = &m;
+        args[i].id = i;
+        expected[i] = 0;
+
+        pthread_create(&producers[i], NULL, mpsc_producer, &args[i]);
+    }
+
+    for (i = 0; i < (RINGBUF_STRESS_COUNT / RINGBUF_MPSC_PRODUCERS) * RINGBUF_MPSC_PRODUCERS; ) {
+        if (size_ringbuf(m.rb) >= RINGBUF_MPSC_RECORD) {
+            ringbuf_get_block(&m.rb, record, RINGBUF_MPSC_RECORD);
+
+            seq = record[1] | (record[2] << 8) | ((uint32_t)record[3] << 16);
+
+            assert(record[0] < RINGBUF_MPSC_PRODUCERS, "Wrong producer id");
+            assert(expected[record[0]]++ == seq, "Sequence is broken");
+            i++;
+        } else {
+            sched_yield();
+        }
+    }
+
+    for (i = 0; i < RINGBUF_MPSC_PRODUCERS; i++) {
+        pthread_join(producers[i], NULL);
+    }
+
+    assert(size_ringbuf(m.rb) == 0, "Should be empty");
+}
+
+/**
+ * @brief Group producer thread, it puts bytes in round-robin over channels.
+ */
+static void * group_producer(void * arg)
+{
+    __ringbuf_group * const g = (__ringbuf_group *)arg;
+    uint32_t i;
+
+    for (i = 0; i < RINGBUF_STRESS_COUNT / 16; ) {
+        if (ringbuf_group_put(g, i & 3, (uint8_t)i)) {
+            i++;
+        } else {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+
+/**
+ *
+ */
+static void ringbuf_group_wait_test(void)
+{
+    uint8_t heap[4][RINGBUF_STRESS_SIZE];
+    uint8_t buf[RINGBUF_STRESS_SIZE];
+    __ringbuf rb[4];
+    __ringbuf_group g;
+    pthread_t producer;
+    uint32_t expected[4];
+    uint32_t total;
+    uint16_t len;
+    uint16_t n;
+    int32_t idx;
+
+    PRINT_TEST_NAME(ringbuf_group_wait_test\r\n);
+
+    init_ringbuf_group(&g);
+
+    for (idx = 0; idx < 4; idx++) {
+        init_ringbuf_spsc(&rb[idx], heap[idx], RINGBUF_STRESS_SIZE);
+        ringbuf_group_add(&g, idx, &rb[idx]);
+        expected[idx] = idx;
+    }
+
+    assert(!ringbuf_group_wait(&g, 1, 10), "Should be timeout");
+
+    pthread_create(&producer, NULL, group_producer, &g);
+
+    for (total = 0; total < RINGBUF_STRESS_COUNT / 16; ) {
+        ringbuf_group_wait(&g, 16, 100);
+
+        while ((idx = ringbuf_group_next(&g)) >= 0) {
+            len = ringbuf_group_get_block(&g, idx, buf, sizeof(buf));
+
+            for (n = 0; n < len; n++) {
+                assert(buf[n] == (uint8_t)expected[idx], "Sequence is broken");
+                expected[idx] += 4;
+            }
+
+            total += len;
+        }
+    }
+
+    pthread_join(producer, NULL);
+
+    assert(ringbuf_group_next(&g) == -1, "All rings should be empty");
+}
+
+#endif /* RINGBUF_HOST_TESTS */
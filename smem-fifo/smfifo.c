@@ -18,14 +18,41 @@
 #define SM_FIFO_END          (handle->fifo_buf + handle->fifo_size - 1)
 #define SM_FIFO_BOUNDARY     (handle->fifo_buf + handle->fifo_size)
 
+/* in_cursor is owned by the open transaction */
+#define SM_FIFO_PUSH_SPACE   (handle->reserved ? 0 : SM_FIFO_SIZE - handle->data_len)
+
+#define SM_FIFO_RECORD_LONG  0x80
+
+
+static uint8_t * cursor_at(struct __smem_fifo_handle * const handle, uint8_t * const cursor, const uint16_t pos);
+static uint8_t * data_at(struct __smem_fifo_handle * const handle, const uint16_t pos);
+static uint8_t segments_at(struct __smem_fifo_handle * const handle, const uint16_t pos, const uint16_t len, __smem_fifo_segment seg[2]);
+static uint8_t record_header(struct __smem_fifo_handle * const handle, uint16_t * const len);
+static void reclaim(struct __smem_fifo_handle * const handle);
+static void copy_in(struct __smem_fifo_handle * const handle, const uint8_t * const src, const uint16_t len);
+static void latency_push(struct __smem_fifo_handle * const handle, const uint16_t len);
+static void latency_pop(struct __smem_fifo_handle * const handle, const uint16_t len);
+
 
 /**
  *
  */
 void smfifo_flush(struct __smem_fifo_handle * const handle)
 {
+    __smem_fifo_reader * reader;
+
     handle->in_cursor = handle->out_cursor = SM_FIFO_START;
     handle->data_len = 0;
+    handle->reserved = 0;
+
+    for (reader = handle->readers; reader; reader = reader->next) {
+        reader->pos = 0;
+    }
+
+    if (handle->latency) {
+        handle->latency->mark_cnt = 0;
+        handle->latency->out_pos = handle->latency->in_pos;
+    }
 }
 
 
@@ -34,7 +61,7 @@ void smfifo_flush(struct __smem_fifo_handle * const handle)
  */
 uint16_t smfifo_available_space(struct __smem_fifo_handle * const handle)
 {
-    return SM_FIFO_SIZE - handle->data_len;
+    return SM_FIFO_SIZE - handle->data_len - handle->reserved;
 }
 
 
@@ -52,7 +79,8 @@ uint16_t smfifo_filled_space(struct __smem_fifo_handle * const handle)
  */
 bool smfifo_push_byte(struct __smem_fifo_handle * const handle, const uint8_t byte)
 {
-    if (SM_FIFO_SIZE - handle->data_len == 0) {
+    if (SM_FIFO_PUSH_SPACE == 0) {
+        QSTAT_OVERFLOW(&handle->stats);
         return false;
     }
 
@@ -63,6 +91,9 @@ bool smfifo_push_byte(struct __smem_fifo_handle * const handle, const uint8_t by
         handle->in_cursor = SM_FIFO_START;
     }
 
+    QSTAT_PUSH(&handle->stats, 1, handle->data_len);
+    latency_push(handle, 1);
+
     return true;
 }
 
@@ -83,9 +114,14 @@ uint8_t smfifo_pop_byte(struct __smem_fifo_handle * const handle)
             handle->out_cursor = SM_FIFO_START;
         }
 
+        QSTAT_POP(&handle->stats, 1);
+        latency_pop(handle, 1);
+
         return byte;
     }
 
+    QSTAT_UNDERFLOW(&handle->stats);
+
     return byte;
 }
 
@@ -97,12 +133,16 @@ bool smfifo_push_data(struct __smem_fifo_handle * const handle, const uint8_t *
 {
     uint16_t push_len;
 
-    if (len > SM_FIFO_SIZE - handle->data_len) {
+    if (len > SM_FIFO_PUSH_SPACE) {
+        QSTAT_OVERFLOW(&handle->stats);
         return false;
     }
 
     handle->data_len += len;
 
+    QSTAT_PUSH(&handle->stats, len, handle->data_len);
+    latency_push(handle, len);
+
     if (handle->in_cursor >= handle->out_cursor) {
         push_len = SM_FIFO_BOUNDARY - handle->in_cursor;
 
@@ -134,11 +174,15 @@ bool smfifo_pop_data(struct __smem_fifo_handle * const handle, uint8_t * const d
     uint16_t pop_len;
 
     if (len > handle->data_len) {
+        QSTAT_UNDERFLOW(&handle->stats);
         return false;
     }
 
     handle->data_len -= len;
 
+    QSTAT_POP(&handle->stats, len);
+    latency_pop(handle, len);
+
     if (handle->out_cursor >= handle->in_cursor) {
         pop_len = SM_FIFO_BOUNDARY - handle->out_cursor;
 
@@ -170,32 +214,39 @@ bool smfifo_pop_data(struct __smem_fifo_handle * const handle, uint8_t * const d
  */
 bool smfifo_replace_data(struct __smem_fifo_handle * const handle, const uint16_t pos, const uint8_t * const src, const uint16_t len)
 {
-    uint8_t * replace_cursor;
-    uint16_t replace_idx;
+    uint8_t * dst;
+    uint16_t run;
 
-    if (!len || (pos + len > handle->data_len)) {
+    if (!len || ((uint32_t)pos + len > handle->data_len)) {
         return false;
     }
 
-    if (handle->out_cursor >= handle->in_cursor) {
+    dst = data_at(handle, pos);
+    run = SM_FIFO_BOUNDARY - dst;
+    run = len < run ? len : run;
 
-        const uint16_t last_pos = SM_FIFO_END - handle->out_cursor;
+    mem_copy(dst, src, run);
+    mem_copy(SM_FIFO_START, src + run, len - run);
 
-        replace_cursor = pos > last_pos ? SM_FIFO_START + (pos - last_pos - 1) : handle->out_cursor + pos;
-    } else {
-        replace_cursor = handle->out_cursor + pos;
-    }
+    return true;
+}
 
-    replace_idx = 0;
 
-    do {
-        *replace_cursor++ = src[replace_idx++];
+/**
+ *
+ */
+bool smfifo_peek_at(struct __smem_fifo_handle * const handle, const uint16_t pos, uint8_t * const dst, const uint16_t len)
+{
+    __smem_fifo_segment seg[2];
 
-        if (replace_cursor > SM_FIFO_END) {
-            replace_cursor = SM_FIFO_START;
-        }
+    if (!len || ((uint32_t)pos + len > handle->data_len)) {
+        return false;
     }
-    while (replace_idx < len);
+
+    segments_at(handle, pos, len, seg);
+
+    mem_copy(dst, seg[0].buf, seg[0].len);
+    mem_copy(dst + seg[0].len, seg[1].buf, seg[1].len);
 
     return true;
 }
@@ -211,7 +262,7 @@ void smfifo_get_cursor(struct __smem_fifo_handle * const handle, const uint8_t *
         *len = 0;
     } else {
         *cursor = handle->out_cursor;
-        *len = handle->out_cursor >= handle->in_cursor
+        *len = handle->out_cursor >= handle->in_cursor && !handle->mirrored
                 ? SM_FIFO_BOUNDARY - handle->out_cursor : handle->data_len;
     }
 }
@@ -230,6 +281,9 @@ bool smfifo_shift_cursor(struct __smem_fifo_handle * const handle, const uint16_
 
     handle->data_len -= len;
 
+    QSTAT_POP(&handle->stats, len);
+    latency_pop(handle, len);
+
     if (handle->out_cursor >= handle->in_cursor) {
         shift_len = SM_FIFO_BOUNDARY - handle->out_cursor;
 
@@ -246,3 +300,542 @@ bool smfifo_shift_cursor(struct __smem_fifo_handle * const handle, const uint16_
 }
 
 
+/**
+ *
+ */
+uint8_t smfifo_get_segments(struct __smem_fifo_handle * const handle, __smem_fifo_segment seg[2])
+{
+    return segments_at(handle, 0, handle->data_len, seg);
+}
+
+
+/**
+ *
+ */
+bool smfifo_push_segments(struct __smem_fifo_handle * const handle, const __smem_fifo_segment * const seg, const uint8_t cnt)
+{
+    uint32_t total;
+    uint8_t i;
+
+    total = 0;
+    for (i = 0; i < cnt; i++) {
+        total += seg[i].len;
+    }
+
+    if (total > (uint32_t)SM_FIFO_PUSH_SPACE) {
+        QSTAT_OVERFLOW(&handle->stats);
+        return false;
+    }
+
+    /* one logical push: one stats event and one latency marker */
+    handle->data_len += total;
+
+    QSTAT_PUSH(&handle->stats, total, handle->data_len);
+    latency_push(handle, total);
+
+    for (i = 0; i < cnt; i++) {
+        copy_in(handle, seg[i].buf, seg[i].len);
+    }
+
+    return true;
+}
+
+
+/**
+ *
+ */
+bool smfifo_push_record(struct __smem_fifo_handle * const handle, const uint8_t * const src, const uint16_t len)
+{
+    uint8_t header[2];
+    __smem_fifo_segment seg[2];
+
+    if (!len || len > SMEM_FIFO_RECORD_MAX_LEN) {
+        return false;
+    }
+
+    if (len < SM_FIFO_RECORD_LONG) {
+        header[0] = (uint8_t)len;
+        seg[0].len = 1;
+    } else {
+        header[0] = SM_FIFO_RECORD_LONG | (uint8_t)(len >> 8);
+        header[1] = (uint8_t)len;
+        seg[0].len = 2;
+    }
+
+    seg[0].buf = header;
+    seg[1].buf = src;
+    seg[1].len = len;
+
+    return smfifo_push_segments(handle, seg, 2);
+}
+
+
+/**
+ *
+ */
+uint16_t smfifo_record_len(struct __smem_fifo_handle * const handle)
+{
+    uint16_t len;
+
+    return record_header(handle, &len) ? len : 0;
+}
+
+
+/**
+ *
+ */
+uint8_t smfifo_peek_record(struct __smem_fifo_handle * const handle, __smem_fifo_segment seg[2])
+{
+    uint16_t len;
+    uint8_t hlen;
+
+    hlen = record_header(handle, &len);
+
+    return segments_at(handle, hlen, hlen ? len : 0, seg);
+}
+
+
+/**
+ *
+ */
+bool smfifo_discard_record(struct __smem_fifo_handle * const handle)
+{
+    uint16_t len;
+    uint8_t hlen;
+
+    hlen = record_header(handle, &len);
+
+    return hlen && smfifo_shift_cursor(handle, hlen + len);
+}
+
+
+/**
+ *
+ */
+bool smfifo_reserve(struct __smem_fifo_handle * const handle, const uint16_t len)
+{
+    if (!len || len > SM_FIFO_PUSH_SPACE) {
+        QSTAT_OVERFLOW(&handle->stats);
+        return false;
+    }
+
+    handle->reserved = len;
+
+    return true;
+}
+
+
+/**
+ *
+ */
+bool smfifo_reserve_write(struct __smem_fifo_handle * const handle, const uint16_t pos, const uint8_t * const src, const uint16_t len)
+{
+    uint8_t * dst;
+    uint16_t run;
+
+    if (!len || (uint32_t)pos + len > handle->reserved) {
+        return false;
+    }
+
+    dst = cursor_at(handle, handle->in_cursor, pos);
+    run = SM_FIFO_BOUNDARY - dst;
+    run = len < run ? len : run;
+
+    mem_copy(dst, src, run);
+    mem_copy(SM_FIFO_START, src + run, len - run);
+
+    return true;
+}
+
+
+/**
+ *
+ */
+bool smfifo_commit(struct __smem_fifo_handle * const handle, const uint16_t len)
+{
+    if (!handle->reserved || len > handle->reserved) {
+        return false;
+    }
+
+    handle->reserved = 0;
+
+    if (len) {
+        handle->in_cursor = cursor_at(handle, handle->in_cursor, len);
+        handle->data_len += len;
+
+        QSTAT_PUSH(&handle->stats, len, handle->data_len);
+        latency_push(handle, len);
+    }
+
+    return true;
+}
+
+
+/**
+ *
+ */
+void smfifo_rollback(struct __smem_fifo_handle * const handle)
+{
+    handle->reserved = 0;
+}
+
+
+/**
+ *
+ */
+void smfifo_attach_reader(struct __smem_fifo_handle * const handle, __smem_fifo_reader * const reader)
+{
+    reader->pos = handle->data_len;
+    reader->next = handle->readers;
+
+    handle->readers = reader;
+
+    /* the data before attach is released if nobody else holds it */
+    reclaim(handle);
+}
+
+
+/**
+ *
+ */
+bool smfifo_detach_reader(struct __smem_fifo_handle * const handle, __smem_fifo_reader * const reader)
+{
+    struct __smem_fifo_reader ** link;
+
+    for (link = &handle->readers; *link; link = &(*link)->next) {
+        if (*link == reader) {
+            *link = reader->next;
+            reader->next = NULL;
+
+            reclaim(handle);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**
+ *
+ */
+uint16_t smfifo_reader_filled(struct __smem_fifo_handle * const handle, __smem_fifo_reader * const reader)
+{
+    return handle->data_len - reader->pos;
+}
+
+
+/**
+ *
+ */
+bool smfifo_reader_pop_data(struct __smem_fifo_handle * const handle, __smem_fifo_reader * const reader, uint8_t * const dst, const uint16_t len)
+{
+    if (!smfifo_peek_at(handle, reader->pos, dst, len)) {
+        QSTAT_UNDERFLOW(&handle->stats);
+        return false;
+    }
+
+    return smfifo_reader_shift(handle, reader, len);
+}
+
+
+/**
+ *
+ */
+uint8_t smfifo_reader_get_segments(struct __smem_fifo_handle * const handle, __smem_fifo_reader * const reader, __smem_fifo_segment seg[2])
+{
+    return segments_at(handle, reader->pos, handle->data_len - reader->pos, seg);
+}
+
+
+/**
+ *
+ */
+bool smfifo_reader_shift(struct __smem_fifo_handle * const handle, __smem_fifo_reader * const reader, const uint16_t len)
+{
+    if (!len || len > handle->data_len - reader->pos) {
+        return false;
+    }
+
+    reader->pos += len;
+
+    reclaim(handle);
+
+    return true;
+}
+
+
+/**
+ *
+ */
+void smfifo_latency_attach(struct __smem_fifo_handle * const handle, __smem_fifo_latency * const latency)
+{
+    if (latency) {
+        latency->mark_first = latency->mark_cnt = 0;
+        latency->sample_idx = latency->sample_cnt = 0;
+        latency->in_pos = latency->out_pos = 0;
+        latency->max = 0;
+    }
+
+    handle->latency = latency;
+}
+
+
+/**
+ *
+ */
+uint16_t smfifo_latency_report(__smem_fifo_latency * const latency, __smem_fifo_latency_report * const report)
+{
+    uint32_t * const samples = latency->samples;
+    const uint16_t cnt = latency->sample_cnt;
+    uint32_t value;
+    uint16_t i;
+    uint16_t j;
+
+    /* insertion sort, the window is small and is dropped after report */
+    for (i = 1; i < cnt; i++) {
+        value = samples[i];
+
+        for (j = i; j > 0 && samples[j - 1] > value; j--) {
+            samples[j] = samples[j - 1];
+        }
+
+        samples[j] = value;
+    }
+
+    report->count = cnt;
+    report->p50 = cnt ? samples[(uint32_t)(cnt - 1) * 50 / 100] : 0;
+    report->p99 = cnt ? samples[(uint32_t)(cnt - 1) * 99 / 100] : 0;
+    report->max = latency->max;
+
+    latency->sample_idx = latency->sample_cnt = 0;
+    latency->max = 0;
+
+    return cnt;
+}
+
+
+/**
+ * @brief Get pointer at pos from the cursor, wrap-safe
+ *
+ * @param handle - pointer on the fifo handle
+ * @param cursor - in_cursor or out_cursor
+ * @param pos - offset from the cursor, no more than fifo size
+ * @return pointer in fifo_buf
+ */
+static uint8_t * cursor_at(struct __smem_fifo_handle * const handle, uint8_t * const cursor, const uint16_t pos)
+{
+    const uint16_t tail = SM_FIFO_BOUNDARY - cursor;
+
+    return pos < tail ? cursor + pos : SM_FIFO_START + (pos - tail);
+}
+
+
+/**
+ * @brief Get pointer on the data byte at pos from the read cursor, wrap-safe
+ *
+ * @param handle - pointer on the fifo handle
+ * @param pos - offset from the read cursor, less than fifo size
+ * @return pointer in fifo_buf
+ */
+static uint8_t * data_at(struct __smem_fifo_handle * const handle, const uint16_t pos)
+{
+    return cursor_at(handle, handle->out_cursor, pos);
+}
+
+
+/**
+ * @brief Split len bytes at pos from the read cursor into no more than two segments
+ *
+ * @param handle - pointer on the fifo handle
+ * @param pos - offset from the read cursor
+ * @param len - length, pos + len should be no more than filled space
+ * @param seg - array of two segments
+ * @return count of non-empty segments
+ */
+static uint8_t segments_at(struct __smem_fifo_handle * const handle, const uint16_t pos, const uint16_t len, __smem_fifo_segment seg[2])
+{
+    uint16_t run;
+
+    seg[0].buf = seg[1].buf = NULL;
+    seg[0].len = seg[1].len = 0;
+
+    if (!len) {
+        return 0;
+    }
+
+    seg[0].buf = data_at(handle, pos);
+
+    run = SM_FIFO_BOUNDARY - seg[0].buf;
+    if (handle->mirrored || len <= run) {
+        seg[0].len = len;
+        return 1;
+    }
+
+    seg[0].len = run;
+    seg[1].buf = SM_FIFO_START;
+    seg[1].len = len - run;
+
+    return 2;
+}
+
+
+/**
+ * @brief Parse the length header of the next record
+ *
+ * @param handle - pointer on the fifo handle
+ * @param len - length of payload
+ * @return size of header, 0 if fifo is empty
+ */
+static uint8_t record_header(struct __smem_fifo_handle * const handle, uint16_t * const len)
+{
+    uint8_t byte;
+
+    if (!handle->data_len) {
+        return 0;
+    }
+
+    byte = *handle->out_cursor;
+
+    if (!(byte & SM_FIFO_RECORD_LONG)) {
+        *len = byte;
+        return 1;
+    }
+
+    *len = ((uint16_t)(byte & ~SM_FIFO_RECORD_LONG) << 8) | *data_at(handle, 1);
+
+    return 2;
+}
+
+
+/**
+ * @brief Release the data consumed by all readers (broadcast mode)
+ *
+ * @param handle - pointer on the fifo handle
+ */
+static void reclaim(struct __smem_fifo_handle * const handle)
+{
+    __smem_fifo_reader * reader;
+    uint16_t slowest;
+
+    if (!handle->readers) {
+        return;
+    }
+
+    slowest = handle->data_len;
+    for (reader = handle->readers; reader; reader = reader->next) {
+        slowest = reader->pos < slowest ? reader->pos : slowest;
+    }
+
+    if (!slowest) {
+        return;
+    }
+
+    smfifo_shift_cursor(handle, slowest);
+
+    for (reader = handle->readers; reader; reader = reader->next) {
+        reader->pos -= slowest;
+    }
+}
+
+
+/**
+ * @brief Copy data at the write cursor with wrap, the space should be checked
+ *
+ * @param handle - pointer on the fifo handle
+ * @param src - data
+ * @param len - length of data
+ */
+static void copy_in(struct __smem_fifo_handle * const handle, const uint8_t * const src, const uint16_t len)
+{
+    const uint16_t tail = SM_FIFO_BOUNDARY - handle->in_cursor;
+
+    if (len < tail) {
+        mem_copy(handle->in_cursor, src, len);
+        handle->in_cursor += len;
+        return;
+    }
+
+    mem_copy(handle->in_cursor, src, tail);
+    handle->in_cursor = SM_FIFO_START;
+
+    if (len - tail) {
+        mem_copy(handle->in_cursor, src + tail, len - tail);
+        handle->in_cursor += len - tail;
+    }
+}
+
+
+/**
+ * @brief Record the marker of pushed chunk
+ *
+ * @param handle - pointer on the fifo handle
+ * @param len - length of chunk
+ */
+static void latency_push(struct __smem_fifo_handle * const handle, const uint16_t len)
+{
+    __smem_fifo_latency * const lat = handle->latency;
+    uint16_t idx;
+
+    if (!lat) {
+        return;
+    }
+
+    if (lat->mark_cnt < lat->marks_size) {
+        idx = lat->mark_first + lat->mark_cnt;
+        idx = idx < lat->marks_size ? idx : idx - lat->marks_size;
+
+        lat->marks[idx].pos = lat->in_pos;
+        lat->marks[idx].ts = lat->timestamp();
+        lat->mark_cnt++;
+    }
+
+    lat->in_pos += len;
+}
+
+
+/**
+ * @brief Match markers of the chunks which have left the fifo
+ *
+ * @param handle - pointer on the fifo handle
+ * @param len - count of popped bytes
+ */
+static void latency_pop(struct __smem_fifo_handle * const handle, const uint16_t len)
+{
+    __smem_fifo_latency * const lat = handle->latency;
+    __smem_fifo_mark * mark;
+    uint32_t now;
+    uint32_t residency;
+
+    if (!lat) {
+        return;
+    }
+
+    lat->out_pos += len;
+
+    if (!lat->mark_cnt) {
+        return;
+    }
+
+    now = lat->timestamp();
+
+    while (lat->mark_cnt) {
+        mark = &lat->marks[lat->mark_first];
+
+        /* the first byte of the chunk is still in the fifo */
+        if ((int32_t)(lat->out_pos - mark->pos) <= 0) {
+            break;
+        }
+
+        residency = now - mark->ts;
+
+        lat->max = residency > lat->max ? residency : lat->max;
+        lat->samples[lat->sample_idx] = residency;
+        lat->sample_idx = lat->sample_idx + 1 < lat->samples_size ? lat->sample_idx + 1 : 0;
+        lat->sample_cnt += lat->sample_cnt < lat->samples_size ? 1 : 0;
+
+        lat->mark_first = lat->mark_first + 1 < lat->marks_size ? lat->mark_first + 1 : 0;
+        lat->mark_cnt--;
+    }
+}
@@ -10,6 +10,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include <qstat.h>
+
 
 #ifndef NUUL
 #define NULL ((void *)0)
@@ -29,15 +31,125 @@
 #define SMEM_FIFO_PUSH_DATA(fh,buf,len)         smfifo_push_data((fh),(buf),(len))
 #define SMEM_FIFO_PUSH_BYTE(fh,byte)            smfifo_push_byte((fh),(byte))
 #define SMEM_FIFO_REPLACE(fh,pos,buf,len)       smfifo_replace_data((fh),(pos),(buf),(len))
+#define SMEM_FIFO_PEEK_AT(fh,pos,buf,len)       smfifo_peek_at((fh),(pos),(buf),(len))
 
 #define SMEM_FIFO_GET_CURSOR(fh,buf,plen)       smfifo_get_cursor((fh),(buf),(plen))
 #define SMEM_FIFO_SHIFT_CURSOR(fh,len)          smfifo_shift_cursor((fh),(len))
 
+#define SMEM_FIFO_GET_SEGMENTS(fh,seg)          smfifo_get_segments((fh),(seg))
+#define SMEM_FIFO_PUSH_SEGMENTS(fh,seg,cnt)     smfifo_push_segments((fh),(seg),(cnt))
+
+#define SMEM_FIFO_PUSH_RECORD(fh,buf,len)       smfifo_push_record((fh),(buf),(len))
+#define SMEM_FIFO_RECORD_LEN(fh)                smfifo_record_len((fh))
+#define SMEM_FIFO_PEEK_RECORD(fh,seg)           smfifo_peek_record((fh),(seg))
+#define SMEM_FIFO_DISCARD_RECORD(fh)            smfifo_discard_record((fh))
+
+#define SMEM_FIFO_RESERVE(fh,len)               smfifo_reserve((fh),(len))
+#define SMEM_FIFO_RESERVE_WRITE(fh,pos,buf,len) smfifo_reserve_write((fh),(pos),(buf),(len))
+#define SMEM_FIFO_COMMIT(fh,len)                smfifo_commit((fh),(len))
+#define SMEM_FIFO_ROLLBACK(fh)                  smfifo_rollback((fh))
+
+#define SMEM_FIFO_ATTACH_READER(fh,rd)          smfifo_attach_reader((fh),(rd))
+#define SMEM_FIFO_DETACH_READER(fh,rd)          smfifo_detach_reader((fh),(rd))
+#define SMEM_FIFO_READER_FILLED(fh,rd)          smfifo_reader_filled((fh),(rd))
+#define SMEM_FIFO_READER_POP_DATA(fh,rd,buf,len)    smfifo_reader_pop_data((fh),(rd),(buf),(len))
+#define SMEM_FIFO_READER_GET_SEGMENTS(fh,rd,seg)    smfifo_reader_get_segments((fh),(rd),(seg))
+#define SMEM_FIFO_READER_SHIFT(fh,rd,len)       smfifo_reader_shift((fh),(rd),(len))
+
+#define SMEM_FIFO_LATENCY_ATTACH(fh,lat)        smfifo_latency_attach((fh),(lat))
+#define SMEM_FIFO_LATENCY_REPORT(lat,rep)       smfifo_latency_report((lat),(rep))
+
+
+/**
+ * @brief Max length of record payload, the length header takes 1 byte
+ *        for payload shorter than 128 bytes and 2 bytes otherwise.
+ */
+#define SMEM_FIFO_RECORD_MAX_LEN                0x7FFF
+
+
+
+
+/**
+ * @brief Segment of data (iovec-like), see "smfifo_get_segments" and "smfifo_push_segments"
+ */
+typedef struct __smem_fifo_segment {
+    const uint8_t * buf;
+    uint16_t len;
+} __smem_fifo_segment;
+
+
+
+/**
+ * @brief Reader cursor for the broadcast mode, see "smfifo_attach_reader"
+ *
+ * @field pos - offset of the next unread byte from out_cursor of the fifo
+ */
+typedef struct __smem_fifo_reader {
+    struct __smem_fifo_reader * next;
+    uint16_t pos;
+} __smem_fifo_reader;
+
+
+
+/**
+ * @brief Marker of pushed chunk: position of its first byte in the stream and push time
+ */
+typedef struct __smem_fifo_mark {
+    uint32_t pos;
+    uint32_t ts;
+} __smem_fifo_mark;
+
+
+/**
+ * @brief Side-table of push timestamps, see "smfifo_latency_attach"
+ *
+ * @field marks - ring of markers, one per push (the push is not marked if the ring is full)
+ * @field samples - residencies of popped markers since the last report
+ *                  (the oldest are overwritten if the window is full)
+ * @field timestamp - platform timestamp source, free-running ticks
+ * @field in_pos / out_pos - free-running counters of pushed / popped bytes
+ * @field max - the max residency since the last report
+ */
+typedef struct __smem_fifo_latency {
+    __smem_fifo_mark * const marks;
+    const uint16_t marks_size;
+    uint32_t * const samples;
+    const uint16_t samples_size;
+    const __qstat_timestamp timestamp;
+
+    uint16_t mark_first;
+    uint16_t mark_cnt;
+    uint16_t sample_idx;
+    uint16_t sample_cnt;
+
+    uint32_t in_pos;
+    uint32_t out_pos;
+    uint32_t max;
+} __smem_fifo_latency;
+
+
+/**
+ * @brief Residency report, ticks of the timestamp source
+ */
+typedef struct __smem_fifo_latency_report {
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+    uint16_t count;
+} __smem_fifo_latency_report;
 
 
 
 /**
  * @brief SMem fifo handle
+ *
+ * @field mirrored - fifo_buf is double-mapped (see "vmring_map" on Linux host),
+ *                   then "smfifo_get_cursor" returns all data as one segment.
+ * @field readers - list of attached readers (broadcast mode), NULL by default
+ * @field latency - side-table of push timestamps, NULL by default
+ * @field reserved - length of the open transaction, see "smfifo_reserve"
+ * @field stats - instrumentation, exists if QSTAT_EN is defined (see "qstat.h"),
+ *                it is not cleared by "smfifo_flush"
  */
 typedef struct __smem_fifo_handle {
 
@@ -48,6 +160,18 @@ typedef struct __smem_fifo_handle {
     uint16_t data_len;
     const uint16_t fifo_size;
 
+    uint16_t reserved;
+
+    struct __smem_fifo_reader * readers;
+
+    struct __smem_fifo_latency * latency;
+
+    const bool mirrored;
+
+#ifdef QSTAT_EN
+    __qstat stats;
+#endif
+
 } __smem_fifo_handle;
 
 
@@ -92,6 +216,17 @@ bool smfifo_pop_data(struct __smem_fifo_handle * const handle, uint8_t * const d
  */
 bool smfifo_replace_data(struct __smem_fifo_handle * const handle, const uint16_t pos, const uint8_t * const src, const uint16_t len);
 
+/**
+ * @brief Copy len bytes at pos from the read cursor without consuming them.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param pos - offset from the read cursor
+ * @param dst - destination buffer
+ * @param len - length of data
+ * @return false if the data runs out of the filled space
+ */
+bool smfifo_peek_at(struct __smem_fifo_handle * const handle, const uint16_t pos, uint8_t * const dst, const uint16_t len);
+
 /**
  *
  */
@@ -102,6 +237,185 @@ void smfifo_get_cursor(struct __smem_fifo_handle * const handle, const uint8_t *
  */
 bool smfifo_shift_cursor(struct __smem_fifo_handle * const handle, const uint16_t len);
 
+/**
+ * @brief Get all queued data as no more than two segments (the second one starts
+ *        at the beginning of fifo_buf after the wrap). Data is not consumed,
+ *        call "smfifo_shift_cursor" with the total length after transmit.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param seg - array of two segments, unused segments get NULL and 0
+ * @return count of non-empty segments, 0..2
+ */
+uint8_t smfifo_get_segments(struct __smem_fifo_handle * const handle, __smem_fifo_segment seg[2]);
+
+/**
+ * @brief Push an array of segments. All or nothing: nothing is pushed
+ *        if the total length is more than the available space.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param seg - array of segments
+ * @param cnt - count of segments
+ * @return false if there is no space
+ */
+bool smfifo_push_segments(struct __smem_fifo_handle * const handle, const __smem_fifo_segment * const seg, const uint8_t cnt);
+
+/**
+ * @brief Record mode. Push a record: the length header and the payload.
+ *        Don't mix the record API with the byte API on the same fifo.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param src - payload
+ * @param len - length of payload, 1..SMEM_FIFO_RECORD_MAX_LEN
+ * @return false if len is wrong or there is no space for the whole record
+ */
+bool smfifo_push_record(struct __smem_fifo_handle * const handle, const uint8_t * const src, const uint16_t len);
+
+/**
+ * @brief Record mode. Get the payload length of the next record.
+ *
+ * @param handle - pointer on the fifo handle
+ * @return length of payload, 0 if fifo is empty
+ */
+uint16_t smfifo_record_len(struct __smem_fifo_handle * const handle);
+
+/**
+ * @brief Record mode. Zero-copy view of the next record payload,
+ *        it is split into two segments if the record is wrapped.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param seg - array of two segments, unused segments get NULL and 0
+ * @return count of non-empty segments, 0 if fifo is empty
+ */
+uint8_t smfifo_peek_record(struct __smem_fifo_handle * const handle, __smem_fifo_segment seg[2]);
+
+/**
+ * @brief Record mode. Discard the next record without copying.
+ *
+ * @param handle - pointer on the fifo handle
+ * @return false if fifo is empty
+ */
+bool smfifo_discard_record(struct __smem_fifo_handle * const handle);
+
+/**
+ * @brief Transaction. Reserve len bytes after the data for building a frame in place.
+ *        Reserved bytes are not visible for the reader until commit.
+ *        Push is rejected while the transaction is open.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param len - length of frame
+ * @return false if there is no space or another transaction is open
+ */
+bool smfifo_reserve(struct __smem_fifo_handle * const handle, const uint16_t len);
+
+/**
+ * @brief Transaction. Write data at pos of the reserved region (any order, rewrite is allowed).
+ *
+ * @param handle - pointer on the fifo handle
+ * @param pos - offset from the start of the reserved region
+ * @param src - data
+ * @param len - length of data
+ * @return false if the data runs out of the reserved region
+ */
+bool smfifo_reserve_write(struct __smem_fifo_handle * const handle, const uint16_t pos, const uint8_t * const src, const uint16_t len);
+
+/**
+ * @brief Transaction. Publish the first len bytes of the reserved region
+ *        and close the transaction, the rest of region is released.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param len - length of frame, no more than reserved
+ * @return false if len is wrong or there is no open transaction
+ */
+bool smfifo_commit(struct __smem_fifo_handle * const handle, const uint16_t len);
+
+/**
+ * @brief Transaction. Release the reserved region, nothing is published.
+ *
+ * @param handle - pointer on the fifo handle
+ */
+void smfifo_rollback(struct __smem_fifo_handle * const handle);
+
+/**
+ * @brief Broadcast mode. Attach a reader, it gets only data pushed after attach.
+ *        Every attached reader gets all data, the space is reclaimed when
+ *        the slowest reader has consumed it. Don't use pop/shift of the fifo
+ *        while readers are attached.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param reader - pointer on the reader, it should not be attached yet
+ */
+void smfifo_attach_reader(struct __smem_fifo_handle * const handle, __smem_fifo_reader * const reader);
+
+/**
+ * @brief Broadcast mode. Detach a reader (e.g. lagging one), the space held by it is reclaimed.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param reader - pointer on the reader
+ * @return false if the reader is not attached
+ */
+bool smfifo_detach_reader(struct __smem_fifo_handle * const handle, __smem_fifo_reader * const reader);
+
+/**
+ * @brief Broadcast mode. Count of bytes unread by the reader (its lag).
+ *
+ * @param handle - pointer on the fifo handle
+ * @param reader - pointer on the reader
+ * @return count of unread bytes
+ */
+uint16_t smfifo_reader_filled(struct __smem_fifo_handle * const handle, __smem_fifo_reader * const reader);
+
+/**
+ * @brief Broadcast mode. Pop data for the reader.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param reader - pointer on the reader
+ * @param dst - destination buffer
+ * @param len - length of data
+ * @return false if the reader has less than len unread bytes
+ */
+bool smfifo_reader_pop_data(struct __smem_fifo_handle * const handle, __smem_fifo_reader * const reader, uint8_t * const dst, const uint16_t len);
+
+/**
+ * @brief Broadcast mode. Zero-copy view of the unread data of the reader,
+ *        call "smfifo_reader_shift" after use.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param reader - pointer on the reader
+ * @param seg - array of two segments
+ * @return count of non-empty segments
+ */
+uint8_t smfifo_reader_get_segments(struct __smem_fifo_handle * const handle, __smem_fifo_reader * const reader, __smem_fifo_segment seg[2]);
+
+/**
+ * @brief Broadcast mode. Consume len bytes by the reader.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param reader - pointer on the reader
+ * @param len - length of data
+ * @return false if the reader has less than len unread bytes
+ */
+bool smfifo_reader_shift(struct __smem_fifo_handle * const handle, __smem_fifo_reader * const reader, const uint16_t len);
+
+/**
+ * @brief Attach the side-table of push timestamps. Every push records a marker,
+ *        pop/shift matches it when the first byte of chunk leaves the fifo.
+ *        Attach it to the empty fifo.
+ *
+ * @param handle - pointer on the fifo handle
+ * @param latency - pointer on the side-table, NULL to detach
+ */
+void smfifo_latency_attach(struct __smem_fifo_handle * const handle, __smem_fifo_latency * const latency);
+
+/**
+ * @brief Get p50/p99/max residency of the chunks popped since the last report
+ *        and start a new window.
+ *
+ * @param latency - pointer on the side-table
+ * @param report - pointer on the report
+ * @return count of samples
+ */
+uint16_t smfifo_latency_report(__smem_fifo_latency * const latency, __smem_fifo_latency_report * const report);
+
 /**
  * @brief Tests
  */
@@ -0,0 +1,308 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ */
+
+
+
+#include "smfifo_seg.h"
+
+#include <shared_utils.h>
+
+
+/**
+ * Private macros
+ *
+ */
+#define SM_SEG_BLOCK_SIZE       SMEM_FIFO_BLOCK_SIZE
+
+
+static bool take_block(struct __smem_seg_fifo_handle * const handle);
+static uint16_t head_run(struct __smem_seg_fifo_handle * const handle);
+static void consume(struct __smem_seg_fifo_handle * const handle, const uint16_t len);
+static void release_block(__smem_block_pool * const pool, __smem_block * const block);
+
+
+/**
+ *
+ */
+void smfifo_pool_init(__smem_block_pool * const pool, __smem_block * const blocks, const uint16_t count)
+{
+    uint16_t i;
+
+    pool->free = NULL;
+    pool->free_cnt = count;
+
+    for (i = count; i > 0; i--) {
+        blocks[i - 1].next = pool->free;
+        pool->free = &blocks[i - 1];
+    }
+}
+
+
+/**
+ *
+ */
+void smfifo_seg_flush(struct __smem_seg_fifo_handle * const handle)
+{
+    __smem_block * block;
+
+    while ((block = handle->head) != NULL) {
+        handle->head = block->next;
+
+        release_block(handle->pool, block);
+    }
+
+    handle->tail = NULL;
+    handle->out = handle->in = 0;
+    handle->blocks = 0;
+    handle->data_len = 0;
+}
+
+
+/**
+ *
+ */
+uint32_t smfifo_seg_available_space(struct __smem_seg_fifo_handle * const handle)
+{
+    uint32_t blocks;
+    uint32_t limit;
+
+    blocks = handle->pool->free_cnt;
+
+    if (handle->max_blocks) {
+        limit = (uint32_t)(handle->max_blocks - handle->blocks);
+        blocks = limit < blocks ? limit : blocks;
+    }
+
+    return blocks * SM_SEG_BLOCK_SIZE + (handle->tail ? SM_SEG_BLOCK_SIZE - handle->in : 0);
+}
+
+
+/**
+ *
+ */
+uint32_t smfifo_seg_filled_space(struct __smem_seg_fifo_handle * const handle)
+{
+    return handle->data_len;
+}
+
+
+/**
+ *
+ */
+bool smfifo_seg_push_byte(struct __smem_seg_fifo_handle * const handle, const uint8_t byte)
+{
+    return smfifo_seg_push_data(handle, &byte, 1);
+}
+
+
+/**
+ *
+ */
+bool smfifo_seg_push_data(struct __smem_seg_fifo_handle * const handle, const uint8_t * const src, const uint16_t len)
+{
+    uint16_t pushed;
+    uint16_t run;
+
+    if (len > smfifo_seg_available_space(handle)) {
+        return false;
+    }
+
+    pushed = 0;
+
+    while (pushed < len) {
+        if (!handle->tail || handle->in == SM_SEG_BLOCK_SIZE) {
+            take_block(handle);
+        }
+
+        run = SM_SEG_BLOCK_SIZE - handle->in;
+        run = len - pushed < run ? len - pushed : run;
+
+        mem_copy(handle->tail->data + handle->in, src + pushed, run);
+
+        handle->in += run;
+        pushed += run;
+    }
+
+    handle->data_len += len;
+
+    return true;
+}
+
+
+/**
+ *
+ */
+uint8_t smfifo_seg_pop_byte(struct __smem_seg_fifo_handle * const handle)
+{
+    uint8_t byte;
+
+    byte = 0;
+    smfifo_seg_pop_data(handle, &byte, 1);
+
+    return byte;
+}
+
+
+/**
+ *
+ */
+bool smfifo_seg_pop_data(struct __smem_seg_fifo_handle * const handle, uint8_t * const dst, const uint16_t len)
+{
+    uint16_t popped;
+    uint16_t run;
+
+    if (len > handle->data_len) {
+        return false;
+    }
+
+    popped = 0;
+
+    while (popped < len) {
+        run = head_run(handle);
+        run = len - popped < run ? len - popped : run;
+
+        mem_copy(dst + popped, handle->head->data + handle->out, run);
+
+        consume(handle, run);
+        popped += run;
+    }
+
+    return true;
+}
+
+
+/**
+ *
+ */
+void smfifo_seg_get_cursor(struct __smem_seg_fifo_handle * const handle, const uint8_t ** cursor, uint16_t * len)
+{
+    if (!handle->data_len) {
+        *cursor = NULL;
+        *len = 0;
+    } else {
+        *cursor = handle->head->data + handle->out;
+        *len = head_run(handle);
+    }
+}
+
+
+/**
+ *
+ */
+bool smfifo_seg_shift_cursor(struct __smem_seg_fifo_handle * const handle, const uint16_t len)
+{
+    uint16_t shifted;
+    uint16_t run;
+
+    if (!len || len > handle->data_len) {
+        return false;
+    }
+
+    shifted = 0;
+
+    while (shifted < len) {
+        run = head_run(handle);
+        run = len - shifted < run ? len - shifted : run;
+
+        consume(handle, run);
+        shifted += run;
+    }
+
+    return true;
+}
+
+
+/**
+ * @brief Take a free block from the pool and link it after tail
+ *
+ * @param handle - pointer on the fifo handle
+ * @return false if the pool is empty
+ */
+static bool take_block(struct __smem_seg_fifo_handle * const handle)
+{
+    __smem_block * const block = handle->pool->free;
+
+    if (!block) {
+        return false;
+    }
+
+    handle->pool->free = block->next;
+    handle->pool->free_cnt--;
+
+    block->next = NULL;
+
+    if (handle->tail) {
+        handle->tail->next = block;
+    } else {
+        handle->head = block;
+        handle->out = 0;
+    }
+
+    handle->tail = block;
+    handle->in = 0;
+    handle->blocks++;
+
+    return true;
+}
+
+
+/**
+ * @brief Get count of contiguous data bytes in the head block
+ *
+ * @param handle - pointer on the fifo handle
+ * @return count of bytes
+ */
+static uint16_t head_run(struct __smem_seg_fifo_handle * const handle)
+{
+    if (!handle->head) {
+        return 0;
+    }
+
+    return (handle->head == handle->tail ? handle->in : SM_SEG_BLOCK_SIZE) - handle->out;
+}
+
+
+/**
+ * @brief Consume bytes of the head block, the drained block is returned to the pool
+ *
+ * @param handle - pointer on the fifo handle
+ * @param len - count of bytes, no more than head_run()
+ */
+static void consume(struct __smem_seg_fifo_handle * const handle, const uint16_t len)
+{
+    __smem_block * const block = handle->head;
+
+    handle->out += len;
+    handle->data_len -= len;
+
+    if (handle->out < SM_SEG_BLOCK_SIZE && handle->data_len) {
+        return;
+    }
+
+    /* the head block is drained */
+    handle->head = block->next;
+    handle->out = 0;
+    handle->blocks--;
+
+    if (!handle->head) {
+        handle->tail = NULL;
+        handle->in = 0;
+    }
+
+    release_block(handle->pool, block);
+}
+
+
+/**
+ * @brief Return block to the pool
+ *
+ * @param pool - pointer on the pool
+ * @param block - pointer on the block
+ */
+static void release_block(__smem_block_pool * const pool, __smem_block * const block)
+{
+    block->next = pool->free;
+    pool->free = block;
+    pool->free_cnt++;
+}
@@ -0,0 +1,154 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ *
+ * Segmented fifo. Data is kept in a chain of fixed-size blocks taken from
+ * a static block pool shared by several fifos. The fifo grows under bursts
+ * and returns blocks to the pool when they are drained, so the RAM is sized
+ * for the sum of average loads instead of the worst case of every channel.
+ *
+ * The API is the same as "smfifo.h". There is no heap, no locks: don't
+ * use fifos of one pool from different contexts concurrently.
+ */
+
+
+#ifndef __SMEM_FIFO_SEG_H
+#define __SMEM_FIFO_SEG_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+#ifndef NULL
+#define NULL ((void *)0)
+#endif
+
+
+/**
+ * Size of data of one block, it may be redefined in system.
+ */
+#ifndef SMEM_FIFO_BLOCK_SIZE
+#define SMEM_FIFO_BLOCK_SIZE                        32
+#endif
+
+
+
+/**
+ * @brief Public API macros.
+ *
+ */
+#define SMEM_SEG_FIFO_FLUSH(fh)                     smfifo_seg_flush((fh))
+#define SMEM_SEG_FIFO_AVAILABLE_SPACE(fh)           smfifo_seg_available_space((fh))
+#define SMEM_SEG_FIFO_FILLED_SPACE(fh)              smfifo_seg_filled_space((fh))
+#define SMEM_SEG_FIFO_POP_DATA(fh,buf,len)          smfifo_seg_pop_data((fh),(buf),(len))
+#define SMEM_SEG_FIFO_POP_BYTE(fh)                  smfifo_seg_pop_byte((fh))
+#define SMEM_SEG_FIFO_PUSH_DATA(fh,buf,len)         smfifo_seg_push_data((fh),(buf),(len))
+#define SMEM_SEG_FIFO_PUSH_BYTE(fh,byte)            smfifo_seg_push_byte((fh),(byte))
+
+#define SMEM_SEG_FIFO_GET_CURSOR(fh,buf,plen)       smfifo_seg_get_cursor((fh),(buf),(plen))
+#define SMEM_SEG_FIFO_SHIFT_CURSOR(fh,len)          smfifo_seg_shift_cursor((fh),(len))
+
+
+
+/**
+ * @brief Block of the pool
+ */
+typedef struct __smem_block {
+    struct __smem_block * next;
+    uint8_t data[SMEM_FIFO_BLOCK_SIZE];
+} __smem_block;
+
+
+/**
+ * @brief Pool of free blocks
+ */
+typedef struct __smem_block_pool {
+    __smem_block * free;
+    uint16_t free_cnt;
+} __smem_block_pool;
+
+
+/**
+ * @brief Segmented fifo handle
+ *
+ * @field pool - pool of blocks, may be shared by several fifos
+ * @field max_blocks - limit of blocks held by this fifo, 0 - no limit
+ * @field head / out - the oldest block and the read offset in it
+ * @field tail / in - the newest block and the write offset in it
+ */
+typedef struct __smem_seg_fifo_handle {
+
+    __smem_block_pool * const pool;
+    const uint16_t max_blocks;
+
+    __smem_block * head;
+    __smem_block * tail;
+    uint16_t out;
+    uint16_t in;
+
+    uint16_t blocks;
+    uint32_t data_len;
+
+} __smem_seg_fifo_handle;
+
+
+
+/**
+ * @brief Initialize pool by an array of blocks, e.g. "static __smem_block blocks[64];"
+ *
+ * @param pool - pointer on the pool
+ * @param blocks - array of blocks
+ * @param count - count of blocks
+ */
+void smfifo_pool_init(__smem_block_pool * const pool, __smem_block * const blocks, const uint16_t count);
+
+/**
+ * @brief Drop all data, blocks are returned to the pool. Call it once before use,
+ *        like "smfifo_flush".
+ */
+void smfifo_seg_flush(struct __smem_seg_fifo_handle * const handle);
+
+/**
+ * @brief Free space: the rest of the last block and free blocks of the pool
+ *        (no more than max_blocks). The pool is shared, so other fifos may take it.
+ */
+uint32_t smfifo_seg_available_space(struct __smem_seg_fifo_handle * const handle);
+
+/**
+ *
+ */
+uint32_t smfifo_seg_filled_space(struct __smem_seg_fifo_handle * const handle);
+
+/**
+ *
+ */
+bool smfifo_seg_push_byte(struct __smem_seg_fifo_handle * const handle, const uint8_t byte);
+
+/**
+ * @brief Push data, all or nothing.
+ */
+bool smfifo_seg_push_data(struct __smem_seg_fifo_handle * const handle, const uint8_t * const src, const uint16_t len);
+
+/**
+ *
+ */
+uint8_t smfifo_seg_pop_byte(struct __smem_seg_fifo_handle * const handle);
+
+/**
+ *
+ */
+bool smfifo_seg_pop_data(struct __smem_seg_fifo_handle * const handle, uint8_t * const dst, const uint16_t len);
+
+/**
+ * @brief Get the contiguous data of the oldest block
+ */
+void smfifo_seg_get_cursor(struct __smem_seg_fifo_handle * const handle, const uint8_t ** cursor, uint16_t * len);
+
+/**
+ *
+ */
+bool smfifo_seg_shift_cursor(struct __smem_seg_fifo_handle * const handle, const uint16_t len);
+
+
+
+#endif /* __SMEM_FIFO_SEG_H */
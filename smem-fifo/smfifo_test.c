@@ -5,6 +5,7 @@
 
 
 #include "smfifo.h"
+#include "smfifo_seg.h"
 
 #include <v_printf.h>
 #include <shared_utils.h>
@@ -34,6 +35,17 @@ static void smem_fifo_replace_test(__smem_fifo_handle *handle);
 static void smem_fifo_cursor_test(__smem_fifo_handle *handle);
 static void smem_fifo_boundary_test(__smem_fifo_handle *handle);
 static void smem_fifo_final_test(__smem_fifo_handle *handle);
+static void smem_fifo_segments_test(__smem_fifo_handle *handle);
+static void smem_fifo_record_test(__smem_fifo_handle *handle);
+static void smem_fifo_transaction_test(__smem_fifo_handle *handle);
+static void smem_fifo_peek_at_test(__smem_fifo_handle *handle);
+static void smem_fifo_readers_test(__smem_fifo_handle *handle);
+static void smem_fifo_seg_test(void);
+static void smem_fifo_latency_test(__smem_fifo_handle *handle);
+
+#ifdef QSTAT_EN
+static void smem_fifo_stats_test(__smem_fifo_handle *handle);
+#endif
 
 
 
@@ -80,6 +92,39 @@ void smem_fifo_run_tests(void)
     smem_fifo_final_test(&smfifo);
     SMEM_FIFO_FLUSH(&smfifo);
 
+    /*******/
+    smem_fifo_segments_test(&smfifo);
+    SMEM_FIFO_FLUSH(&smfifo);
+
+    /*******/
+    smem_fifo_record_test(&smfifo);
+    SMEM_FIFO_FLUSH(&smfifo);
+
+    /*******/
+    smem_fifo_transaction_test(&smfifo);
+    SMEM_FIFO_FLUSH(&smfifo);
+
+    /*******/
+    smem_fifo_peek_at_test(&smfifo);
+    SMEM_FIFO_FLUSH(&smfifo);
+
+    /*******/
+    smem_fifo_readers_test(&smfifo);
+    SMEM_FIFO_FLUSH(&smfifo);
+
+    /*******/
+    smem_fifo_seg_test();
+
+    /*******/
+    smem_fifo_latency_test(&smfifo);
+    SMEM_FIFO_FLUSH(&smfifo);
+
+#ifdef QSTAT_EN
+    /*******/
+    smem_fifo_stats_test(&smfifo);
+    SMEM_FIFO_FLUSH(&smfifo);
+#endif
+
     v_printf("SMEM Fifo tests have finished successfully\r\n", 1);
 }
 
@@ -342,3 +387,396 @@ static void smem_fifo_final_test(__smem_fifo_handle *handle)
 }
 
 
+/**
+ *
+ */
+static void smem_fifo_segments_test(__smem_fifo_handle *handle)
+{
+    uint8_t buf[FIFO_HEAP_SIZE + 1];
+    __smem_fifo_segment seg[3];
+
+    PRINT_TEST_NAME(smem_fifo_segments_test\r\n);
+
+    assert(!SMEM_FIFO_FILLED_SPACE(handle), "Fifo should be empty");
+    assert(SMEM_FIFO_GET_SEGMENTS(handle, seg) == 0 && seg[0].len == 0, "Should be 0 segments");
+
+    SMEM_FIFO_PUSH_DATA(handle, (const uint8_t * const)"abcd", 4);
+    SMEM_FIFO_POP_DATA(handle, buf, 3);
+    SMEM_FIFO_PUSH_DATA(handle, (const uint8_t * const)"xyz", 3);
+
+    /* data is wrapped: "dx" at the end of buffer, "yz" at the start */
+    assert(SMEM_FIFO_GET_SEGMENTS(handle, seg) == 2, "Should be 2 segments");
+    assert(seg[0].len == 2 && seg[0].buf[0] == 'd' && seg[0].buf[1] == 'x', "Wrong first segment");
+    assert(seg[1].len == 2 && seg[1].buf[0] == 'y' && seg[1].buf[1] == 'z', "Wrong second segment");
+
+    SMEM_FIFO_SHIFT_CURSOR(handle, seg[0].len + seg[1].len);
+    assert(!SMEM_FIFO_FILLED_SPACE(handle), "Fifo should be empty after shifting");
+
+    seg[0].buf = (const uint8_t *)"ab";
+    seg[0].len = 2;
+    seg[1].buf = NULL;
+    seg[1].len = 0;
+    seg[2].buf = (const uint8_t *)"cde";
+    seg[2].len = 3;
+
+    assert(SMEM_FIFO_PUSH_SEGMENTS(handle, seg, 3), "Should be OK");
+    assert(!SMEM_FIFO_PUSH_SEGMENTS(handle, seg, 1), "Fifo is full");
+    assert(SMEM_FIFO_GET_SEGMENTS(handle, seg) == 2, "Should be 2 segments");
+
+    SMEM_FIFO_POP_DATA(handle, buf, 5);
+    buf[5] = 0;
+
+    assert(str_cmp((const char *)buf, "abcde"), "Push segments is worked wrong");
+}
+
+
+/**
+ *
+ */
+static void smem_fifo_record_test(__smem_fifo_handle *handle)
+{
+    uint8_t small_buf[8];
+    uint8_t big_buf[160];
+    uint8_t record[130];
+    __smem_fifo_segment seg[2];
+
+    __smem_fifo_handle small = {.fifo_buf = small_buf, .fifo_size = sizeof(small_buf)};
+    __smem_fifo_handle big = {.fifo_buf = big_buf, .fifo_size = sizeof(big_buf)};
+
+    PRINT_TEST_NAME(smem_fifo_record_test\r\n);
+
+    assert(!SMEM_FIFO_FILLED_SPACE(handle), "Fifo should be empty");
+
+    SMEM_FIFO_FLUSH(&small);
+    SMEM_FIFO_FLUSH(&big);
+
+    assert(!SMEM_FIFO_RECORD_LEN(&small), "Should be 0");
+    assert(!SMEM_FIFO_DISCARD_RECORD(&small), "Fifo is empty");
+    assert(!SMEM_FIFO_PUSH_RECORD(&small, (const uint8_t *)"", 0), "Empty record");
+
+    assert(SMEM_FIFO_PUSH_RECORD(&small, (const uint8_t *)"abcde", 5), "Should be OK");
+    assert(!SMEM_FIFO_PUSH_RECORD(&small, (const uint8_t *)"xyz", 3), "Whole record doesn't fit");
+    assert(SMEM_FIFO_FILLED_SPACE(&small) == 6, "Should be 6");
+    assert(SMEM_FIFO_RECORD_LEN(&small) == 5, "Should be 5");
+    assert(SMEM_FIFO_DISCARD_RECORD(&small), "Should be OK");
+
+    /* header and 'x' at the end of buffer, "yz" at the start */
+    assert(SMEM_FIFO_PUSH_RECORD(&small, (const uint8_t *)"xyz", 3), "Should be OK");
+    assert(SMEM_FIFO_RECORD_LEN(&small) == 3, "Should be 3");
+    assert(SMEM_FIFO_PEEK_RECORD(&small, seg) == 2, "Should be 2 segments");
+    assert(seg[0].len == 1 && seg[0].buf[0] == 'x', "Wrong first segment");
+    assert(seg[1].len == 2 && seg[1].buf[0] == 'y' && seg[1].buf[1] == 'z', "Wrong second segment");
+    assert(SMEM_FIFO_DISCARD_RECORD(&small), "Should be OK");
+    assert(!SMEM_FIFO_FILLED_SPACE(&small), "Fifo should be empty");
+
+    /* two-byte header */
+    mem_set(record, 0x5A, sizeof(record));
+    assert(!SMEM_FIFO_PUSH_RECORD(&big, record, SMEM_FIFO_RECORD_MAX_LEN + 1), "Too long record");
+    assert(SMEM_FIFO_PUSH_RECORD(&big, record, sizeof(record)), "Should be OK");
+    assert(SMEM_FIFO_PUSH_RECORD(&big, (const uint8_t *)"q", 1), "Should be OK");
+    assert(SMEM_FIFO_FILLED_SPACE(&big) == sizeof(record) + 4, "Wrong filled space");
+    assert(SMEM_FIFO_RECORD_LEN(&big) == sizeof(record), "Wrong record length");
+    assert(SMEM_FIFO_PEEK_RECORD(&big, seg) == 1 && seg[0].len == sizeof(record), "Should be 1 segment");
+    assert(mem_cmp(seg[0].buf, record, sizeof(record)), "Wrong record");
+
+    SMEM_FIFO_DISCARD_RECORD(&big);
+    assert(SMEM_FIFO_PEEK_RECORD(&big, seg) == 1 && seg[0].buf[0] == 'q', "Wrong record");
+}
+
+
+/**
+ *
+ */
+static void smem_fifo_transaction_test(__smem_fifo_handle *handle)
+{
+    uint8_t buf[FIFO_HEAP_SIZE + 1];
+
+    PRINT_TEST_NAME(smem_fifo_transaction_test\r\n);
+
+    assert(!SMEM_FIFO_FILLED_SPACE(handle), "Fifo should be empty");
+    assert(!SMEM_FIFO_COMMIT(handle, 0), "No transaction");
+
+    SMEM_FIFO_PUSH_DATA(handle, (const uint8_t * const)"ab", 2);
+    SMEM_FIFO_POP_BYTE(handle);
+
+    assert(!SMEM_FIFO_RESERVE(handle, 5), "No space");
+    assert(SMEM_FIFO_RESERVE(handle, 4), "Should be OK");
+    assert(!SMEM_FIFO_RESERVE(handle, 1), "Transaction is open");
+    assert(!SMEM_FIFO_PUSH_BYTE(handle, 'c'), "Push is rejected while transaction is open");
+    assert(!SMEM_FIFO_AVAILABLE_SPACE(handle), "Should be 0");
+
+    /* body first, the header is patched later, the frame is wrapped */
+    assert(SMEM_FIFO_RESERVE_WRITE(handle, 1, (const uint8_t *)"xyz", 3), "Should be OK");
+    assert(!SMEM_FIFO_RESERVE_WRITE(handle, 2, (const uint8_t *)"xyz", 3), "Out of reserved region");
+    assert(SMEM_FIFO_RESERVE_WRITE(handle, 0, (const uint8_t *)"H", 1), "Should be OK");
+
+    assert(SMEM_FIFO_FILLED_SPACE(handle) == 1, "Reader should not see the frame");
+    assert(SMEM_FIFO_COMMIT(handle, 4), "Should be OK");
+    assert(SMEM_FIFO_FILLED_SPACE(handle) == 5, "Should be 5");
+
+    SMEM_FIFO_POP_DATA(handle, buf, 5);
+    buf[5] = 0;
+
+    assert(str_cmp((const char *)buf, "bHxyz"), "Transaction is worked wrong");
+
+    /* rollback */
+    assert(SMEM_FIFO_RESERVE(handle, 2), "Should be OK");
+    SMEM_FIFO_RESERVE_WRITE(handle, 0, (const uint8_t *)"--", 2);
+    SMEM_FIFO_ROLLBACK(handle);
+
+    assert(!SMEM_FIFO_FILLED_SPACE(handle), "Fifo should be empty");
+    assert(SMEM_FIFO_PUSH_DATA(handle, (const uint8_t * const)"ok", 2), "Should be OK");
+
+    SMEM_FIFO_POP_DATA(handle, buf, 2);
+    buf[2] = 0;
+
+    assert(str_cmp((const char *)buf, "ok"), "Rollback is worked wrong");
+}
+
+
+/**
+ *
+ */
+static void smem_fifo_peek_at_test(__smem_fifo_handle *handle)
+{
+    uint8_t buf[FIFO_HEAP_SIZE + 1];
+
+    PRINT_TEST_NAME(smem_fifo_peek_at_test\r\n);
+
+    assert(!SMEM_FIFO_FILLED_SPACE(handle), "Fifo should be empty");
+
+    SMEM_FIFO_PUSH_DATA(handle, (const uint8_t * const)"abcd", 4);
+    SMEM_FIFO_POP_DATA(handle, buf, 3);
+    SMEM_FIFO_PUSH_DATA(handle, (const uint8_t * const)"wxyz", 4);
+
+    /* "dw" at the end of buffer, "xyz" at the start */
+    assert(SMEM_FIFO_PEEK_AT(handle, 1, buf, 3), "Should be OK");
+    buf[3] = 0;
+
+    assert(str_cmp((const char *)buf, "wxy"), "Peek at is worked wrong");
+    assert(SMEM_FIFO_FILLED_SPACE(handle) == 5, "Peek should not consume data");
+    assert(!SMEM_FIFO_PEEK_AT(handle, 3, buf, 3), "Out of filled space");
+
+    assert(SMEM_FIFO_REPLACE(handle, 1, (const uint8_t * const)"WX", 2), "Should be OK");
+    assert(!SMEM_FIFO_REPLACE(handle, 4, (const uint8_t * const)"WX", 2), "Out of filled space");
+
+    SMEM_FIFO_POP_DATA(handle, buf, 5);
+    buf[5] = 0;
+
+    assert(str_cmp((const char *)buf, "dWXyz"), "Replace is worked wrong");
+}
+
+
+/**
+ *
+ */
+static void smem_fifo_readers_test(__smem_fifo_handle *handle)
+{
+    uint8_t buf[FIFO_HEAP_SIZE + 1];
+    __smem_fifo_reader logger;
+    __smem_fifo_reader parser;
+    __smem_fifo_segment seg[2];
+
+    PRINT_TEST_NAME(smem_fifo_readers_test\r\n);
+
+    assert(!SMEM_FIFO_FILLED_SPACE(handle), "Fifo should be empty");
+
+    SMEM_FIFO_ATTACH_READER(handle, &logger);
+    SMEM_FIFO_ATTACH_READER(handle, &parser);
+
+    SMEM_FIFO_PUSH_DATA(handle, (const uint8_t * const)"abc", 3);
+
+    assert(SMEM_FIFO_READER_POP_DATA(handle, &logger, buf, 3), "Should be OK");
+    buf[3] = 0;
+
+    assert(str_cmp((const char *)buf, "abc"), "Logger got wrong data");
+    assert(!SMEM_FIFO_READER_FILLED(handle, &logger), "Logger should be empty");
+    assert(SMEM_FIFO_READER_FILLED(handle, &parser) == 3, "Parser should have 3 bytes");
+
+    /* the slowest reader holds the space */
+    assert(SMEM_FIFO_AVAILABLE_SPACE(handle) == 2, "Should be 2");
+
+    assert(SMEM_FIFO_READER_POP_DATA(handle, &parser, buf, 1) && buf[0] == 'a', "Parser got wrong data");
+    assert(SMEM_FIFO_AVAILABLE_SPACE(handle) == 3, "Should be 3");
+
+    SMEM_FIFO_PUSH_DATA(handle, (const uint8_t * const)"def", 3);
+    assert(!SMEM_FIFO_PUSH_BYTE(handle, 'g'), "Fifo is full");
+
+    /* the lagging parser is detached, logger keeps going */
+    assert(SMEM_FIFO_DETACH_READER(handle, &parser), "Should be OK");
+    assert(!SMEM_FIFO_DETACH_READER(handle, &parser), "Parser is not attached");
+    assert(SMEM_FIFO_AVAILABLE_SPACE(handle) == 2, "Should be 2");
+
+    /* "de" at the end of buffer, "f" at the start */
+    assert(SMEM_FIFO_READER_GET_SEGMENTS(handle, &logger, seg) == 2, "Should be 2 segments");
+    assert(seg[0].len == 2 && seg[0].buf[0] == 'd' && seg[1].len == 1 && seg[1].buf[0] == 'f', "Wrong segments");
+    assert(SMEM_FIFO_READER_SHIFT(handle, &logger, 3), "Should be OK");
+    assert(!SMEM_FIFO_READER_SHIFT(handle, &logger, 1), "Logger should be empty");
+
+    assert(!SMEM_FIFO_FILLED_SPACE(handle), "Fifo should be empty");
+
+    SMEM_FIFO_DETACH_READER(handle, &logger);
+    assert(handle->readers == NULL, "All readers should be detached");
+}
+
+
+/**
+ *
+ */
+static void smem_fifo_seg_test(void)
+{
+    static __smem_block blocks[4];
+    __smem_block_pool pool;
+
+    uint8_t src[3 * SMEM_FIFO_BLOCK_SIZE];
+    uint8_t dst[3 * SMEM_FIFO_BLOCK_SIZE];
+    const uint8_t * buf;
+    uint16_t len;
+    uint16_t i;
+
+    __smem_seg_fifo_handle rx = {.pool = &pool, .max_blocks = 3};
+    __smem_seg_fifo_handle tx = {.pool = &pool};
+
+    PRINT_TEST_NAME(smem_fifo_seg_test\r\n);
+
+    smfifo_pool_init(&pool, blocks, 4);
+
+    SMEM_SEG_FIFO_FLUSH(&rx);
+    SMEM_SEG_FIFO_FLUSH(&tx);
+
+    for (i = 0; i < sizeof(src); i++) {
+        src[i] = (uint8_t)i;
+    }
+
+    assert(SMEM_SEG_FIFO_AVAILABLE_SPACE(&rx) == 3 * SMEM_FIFO_BLOCK_SIZE, "Limited by max_blocks");
+    assert(SMEM_SEG_FIFO_AVAILABLE_SPACE(&tx) == 4 * SMEM_FIFO_BLOCK_SIZE, "Whole pool");
+
+    /* burst: rx takes 3 blocks, tx gets only the last one */
+    assert(!SMEM_SEG_FIFO_PUSH_DATA(&rx, src, sizeof(src) + 1), "No space");
+    assert(SMEM_SEG_FIFO_PUSH_DATA(&rx, src, sizeof(src) - 2), "Should be OK");
+    assert(rx.blocks == 3 && pool.free_cnt == 1, "Should take 3 blocks");
+
+    assert(!SMEM_SEG_FIFO_PUSH_DATA(&tx, src, SMEM_FIFO_BLOCK_SIZE + 1), "No space in pool");
+    assert(SMEM_SEG_FIFO_PUSH_BYTE(&tx, 'a'), "Should be OK");
+    assert(SMEM_SEG_FIFO_AVAILABLE_SPACE(&tx) == SMEM_FIFO_BLOCK_SIZE - 1, "Should be the rest of block");
+
+    SMEM_SEG_FIFO_GET_CURSOR(&rx, &buf, &len);
+    assert(len == SMEM_FIFO_BLOCK_SIZE && buf[0] == 0, "Cursor should be the first block");
+
+    assert(SMEM_SEG_FIFO_SHIFT_CURSOR(&rx, 2), "Should be OK");
+    assert(SMEM_SEG_FIFO_POP_DATA(&rx, dst, SMEM_FIFO_BLOCK_SIZE), "Should be OK");
+    assert(mem_cmp(dst, src + 2, SMEM_FIFO_BLOCK_SIZE), "Wrong data");
+
+    /* the first block is drained and returned */
+    assert(rx.blocks == 2 && pool.free_cnt == 1, "Should be 2 blocks");
+    assert(SMEM_SEG_FIFO_FILLED_SPACE(&rx) == sizeof(src) - 4 - SMEM_FIFO_BLOCK_SIZE, "Wrong filled space");
+
+    assert(SMEM_SEG_FIFO_POP_DATA(&rx, dst, SMEM_SEG_FIFO_FILLED_SPACE(&rx)), "Should be OK");
+    assert(mem_cmp(dst, src + 2 + SMEM_FIFO_BLOCK_SIZE, sizeof(src) - 4 - SMEM_FIFO_BLOCK_SIZE), "Wrong data");
+    assert(rx.blocks == 0 && pool.free_cnt == 3, "All blocks should be returned");
+
+    assert(SMEM_SEG_FIFO_POP_BYTE(&tx) == 'a', "Wrong data");
+    assert(!SMEM_SEG_FIFO_FILLED_SPACE(&tx) && pool.free_cnt == 4, "Fifo should be empty");
+
+    SMEM_SEG_FIFO_GET_CURSOR(&tx, &buf, &len);
+    assert(buf == NULL && len == 0, "Cursor of empty fifo");
+}
+
+
+static uint32_t test_ticks;
+
+static uint32_t test_timestamp(void)
+{
+    return test_ticks;
+}
+
+
+/**
+ *
+ */
+static void smem_fifo_latency_test(__smem_fifo_handle *handle)
+{
+    uint8_t buf[FIFO_HEAP_SIZE];
+    __smem_fifo_mark marks[4];
+    uint32_t samples[8];
+    __smem_fifo_latency_report report;
+
+    __smem_fifo_latency latency = {
+            .marks = marks,
+            .marks_size = 4,
+            .samples = samples,
+            .samples_size = 8,
+            .timestamp = test_timestamp
+    };
+
+    PRINT_TEST_NAME(smem_fifo_latency_test\r\n);
+
+    assert(!SMEM_FIFO_FILLED_SPACE(handle), "Fifo should be empty");
+
+    SMEM_FIFO_LATENCY_ATTACH(handle, &latency);
+
+    test_ticks = 0;
+    SMEM_FIFO_PUSH_DATA(handle, (const uint8_t * const)"ab", 2);
+    test_ticks = 2;
+    SMEM_FIFO_PUSH_BYTE(handle, 'c');
+    test_ticks = 3;
+    SMEM_FIFO_PUSH_BYTE(handle, 'd');
+
+    /* "ab" leaves with the first byte */
+    test_ticks = 10;
+    SMEM_FIFO_POP_BYTE(handle);
+    assert(latency.sample_cnt == 1 && samples[0] == 10, "Should be 10");
+
+    SMEM_FIFO_POP_DATA(handle, buf, 2);
+    assert(latency.sample_cnt == 2 && samples[1] == 8, "Should be 8");
+
+    test_ticks = 13;
+    SMEM_FIFO_SHIFT_CURSOR(handle, 1);
+
+    assert(SMEM_FIFO_LATENCY_REPORT(&latency, &report) == 3, "Should be 3 samples");
+    assert(report.p50 == 10 && report.p99 == 10 && report.max == 10, "Wrong report");
+
+    assert(!SMEM_FIFO_LATENCY_REPORT(&latency, &report), "Window should be empty");
+    assert(!report.p50 && !report.max, "Wrong report");
+
+    /* the header and the payload of record are one chunk */
+    SMEM_FIFO_PUSH_RECORD(handle, (const uint8_t * const)"xyz", 3);
+    assert(latency.mark_cnt == 1, "Should be 1 marker");
+    SMEM_FIFO_DISCARD_RECORD(handle);
+
+    SMEM_FIFO_LATENCY_ATTACH(handle, NULL);
+}
+
+
+#ifdef QSTAT_EN
+
+/**
+ *
+ */
+static void smem_fifo_stats_test(__smem_fifo_handle *handle)
+{
+    uint8_t buf[FIFO_HEAP_SIZE];
+
+    PRINT_TEST_NAME(smem_fifo_stats_test\r\n);
+
+    assert(!SMEM_FIFO_FILLED_SPACE(handle), "Fifo should be empty");
+
+    qstat_reset(&handle->stats);
+
+    SMEM_FIFO_PUSH_DATA(handle, (const uint8_t * const)"abc", 3);
+    assert(!SMEM_FIFO_POP_DATA(handle, buf, 4), "Should be false");
+    assert(!SMEM_FIFO_PUSH_DATA(handle, (const uint8_t * const)"def", 3), "Should be false");
+    SMEM_FIFO_PUSH_BYTE(handle, 'd');
+
+    SMEM_FIFO_POP_DATA(handle, buf, 3);
+    SMEM_FIFO_POP_BYTE(handle);
+    SMEM_FIFO_POP_BYTE(handle);
+
+    assert(handle->stats.bytes_in == 4 && handle->stats.bytes_out == 4, "Wrong in/out stats");
+    assert(handle->stats.peak == 4, "Should be 4");
+    assert(handle->stats.overflows == 1 && handle->stats.underflows == 2, "Wrong overflow stats");
+
+    qstat_dump(&handle->stats, "smfifo");
+}
+
+#endif /* QSTAT_EN */
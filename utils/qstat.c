@@ -0,0 +1,151 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ */
+
+
+#include "qstat.h"
+#include "shared_utils.h"
+
+#include <v_printf.h>
+
+
+/**
+ * Private macros
+ *
+ * Every counter has only one writer (producer or consumer), so relaxed
+ * load/store is enough. The sample is handed over by acquire/release.
+ */
+#define QS_LOAD_RELAXED(v)         __atomic_load_n(&(v), __ATOMIC_RELAXED)
+#define QS_LOAD_ACQUIRE(v)         __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define QS_STORE_RELEASE(v,x)      __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#define QS_STORE_RELAXED(v,x)      __atomic_store_n(&(v), (x), __ATOMIC_RELAXED)
+
+#define QS_ADD(v,x)                QS_STORE_RELAXED((v), QS_LOAD_RELAXED(v) + (x))
+
+
+static __qstat_timestamp timestamp = 0;
+
+
+static uint8_t hist_bin(uint32_t ticks);
+
+
+/**
+ *
+ */
+void qstat_set_timestamp(const __qstat_timestamp ts)
+{
+    timestamp = ts;
+}
+
+
+/**
+ *
+ */
+void qstat_reset(__qstat * const st)
+{
+    mem_set(st, 0, sizeof(__qstat));
+}
+
+
+/**
+ *
+ */
+void qstat_push(__qstat * const st, const uint16_t len, const uint16_t level)
+{
+    const uint32_t pos = QS_LOAD_RELAXED(st->bytes_in);
+
+    /* start a new sample when the previous one has left the queue */
+    if (timestamp && !QS_LOAD_ACQUIRE(st->sample_busy)) {
+        st->sample_pos = pos;
+        st->sample_ts = timestamp();
+        QS_STORE_RELEASE(st->sample_busy, true);
+    }
+
+    if (level > QS_LOAD_RELAXED(st->peak)) {
+        QS_STORE_RELAXED(st->peak, level);
+    }
+
+    QS_STORE_RELAXED(st->bytes_in, pos + len);
+}
+
+
+/**
+ *
+ */
+void qstat_pop(__qstat * const st, const uint16_t len)
+{
+    const uint32_t pos = QS_LOAD_RELAXED(st->bytes_out);
+    uint8_t bin;
+
+    /* the sampled byte is in [pos, pos + len) */
+    if (timestamp && QS_LOAD_ACQUIRE(st->sample_busy) && (int32_t)(pos + len - st->sample_pos) > 0) {
+        bin = hist_bin(timestamp() - st->sample_ts);
+        QS_ADD(st->hist[bin], 1);
+
+        QS_STORE_RELEASE(st->sample_busy, false);
+    }
+
+    QS_STORE_RELAXED(st->bytes_out, pos + len);
+}
+
+
+/**
+ *
+ */
+void qstat_overflow(__qstat * const st)
+{
+    QS_ADD(st->overflows, 1);
+}
+
+
+/**
+ *
+ */
+void qstat_underflow(__qstat * const st)
+{
+    QS_ADD(st->underflows, 1);
+}
+
+
+/**
+ *
+ */
+void qstat_dump(__qstat * const st, const char * const name)
+{
+    uint8_t i;
+
+    /* "%lu" of v_printf is padded by zeros to sizeof(long) digits */
+    v_printf("%s: in %u out %u peak %u ovf %u unf %u hist",
+            name,
+            QS_LOAD_RELAXED(st->bytes_in),
+            QS_LOAD_RELAXED(st->bytes_out),
+            QS_LOAD_RELAXED(st->peak),
+            QS_LOAD_RELAXED(st->overflows),
+            QS_LOAD_RELAXED(st->underflows));
+
+    for (i = 0; i < QSTAT_HIST_BINS; i++) {
+        v_printf(" %u", QS_LOAD_RELAXED(st->hist[i]));
+    }
+
+    v_printf("\r\n", 1);
+}
+
+
+/**
+ * @brief Get histogram bin of residency, floor(log2(ticks))
+ *
+ * @param ticks - residency
+ * @return number of bin
+ */
+static uint8_t hist_bin(uint32_t ticks)
+{
+    uint8_t bin;
+
+    bin = 0;
+    while (ticks > 1 && bin < QSTAT_HIST_BINS - 1) {
+        ticks >>= 1;
+        bin++;
+    }
+
+    return bin;
+}
@@ -0,0 +1,148 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ */
+
+
+#ifndef __UTILS_QSTAT_H
+#define __UTILS_QSTAT_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**
+ * Queue instrumentation (ringbuf, smfifo).
+ *
+ * It is compiled out by default. To enable it define
+ * macros QSTAT_EN in system, e.g. -DQSTAT_EN
+ *
+ * Counters are written by one producer and one consumer without locks,
+ * "qstat_dump" may be called from any context (e.g. terminal command).
+ */
+
+
+/**
+ * Count of bins of residency histogram. Bin "i" counts the bytes which were
+ * in the queue from 2^i to 2^(i+1) - 1 ticks, bin 0 - less than 2 ticks,
+ * the last bin - all longer residencies.
+ */
+#ifndef QSTAT_HIST_BINS
+#define QSTAT_HIST_BINS        8
+#endif
+
+
+/**
+ * @brief Timestamp source, returns free-running ticks (e.g. SysTick ms or DWT cycles)
+ */
+typedef uint32_t (* __qstat_timestamp)(void);
+
+
+/**
+ * @brief Queue statistics
+ *
+ * @field bytes_in / bytes_out - free-running counters of pushed and popped bytes
+ * @field peak - the highest occupancy seen by push
+ * @field overflows - count of pushes which discarded data (full queue)
+ * @field underflows - count of pops from the empty queue
+ * @field hist - residency histogram, one byte in flight is sampled at a time
+ */
+typedef struct __qstat {
+    uint32_t bytes_in;
+    uint32_t bytes_out;
+    uint32_t overflows;
+    uint32_t underflows;
+    uint16_t peak;
+
+    /* sampled byte: position in the input stream and push time */
+    uint32_t sample_pos;
+    uint32_t sample_ts;
+    bool sample_busy;
+
+    uint32_t hist[QSTAT_HIST_BINS];
+} __qstat;
+
+
+/**
+ * @brief Hooks for queues, they expand to nothing if QSTAT_EN is not defined
+ */
+#ifdef QSTAT_EN
+#define QSTAT_RESET(st)                 qstat_reset((st))
+#define QSTAT_PUSH(st,len,level)        qstat_push((st),(len),(level))
+#define QSTAT_POP(st,len)               qstat_pop((st),(len))
+#define QSTAT_OVERFLOW(st)              qstat_overflow((st))
+#define QSTAT_UNDERFLOW(st)             qstat_underflow((st))
+#else
+#define QSTAT_RESET(st)
+#define QSTAT_PUSH(st,len,level)
+#define QSTAT_POP(st,len)
+#define QSTAT_OVERFLOW(st)
+#define QSTAT_UNDERFLOW(st)
+#endif
+
+
+/**
+ * @brief Set timestamp source for all queues. The residency histogram
+ *        is not collected without it.
+ *
+ * @param ts - timestamp function, NULL to stop sampling
+ */
+void qstat_set_timestamp(const __qstat_timestamp ts);
+
+
+/**
+ * @brief Clear statistics. Both sides of the queue should be stopped.
+ *
+ * @param st - pointer on the __qstat
+ */
+void qstat_reset(__qstat * const st);
+
+
+/**
+ * @brief Producer side. Account pushed bytes.
+ *
+ * @param st - pointer on the __qstat
+ * @param len - count of pushed bytes
+ * @param level - occupancy after push
+ */
+void qstat_push(__qstat * const st, const uint16_t len, const uint16_t level);
+
+
+/**
+ * @brief Consumer side. Account popped bytes.
+ *
+ * @param st - pointer on the __qstat
+ * @param len - count of popped bytes
+ */
+void qstat_pop(__qstat * const st, const uint16_t len);
+
+
+/**
+ * @brief Producer side. Account a push which discarded data.
+ *
+ * @param st - pointer on the __qstat
+ */
+void qstat_overflow(__qstat * const st);
+
+
+/**
+ * @brief Consumer side. Account a pop from the empty queue.
+ *
+ * @param st - pointer on the __qstat
+ */
+void qstat_underflow(__qstat * const st);
+
+
+/**
+ * @brief Print statistics by v_printf, e.g. from a terminal command callback:
+ *
+ *        "rx: in 1024 out 1000 peak 64 ovf 0 unf 3 hist 12 5 1 0 0 0 0 0"
+ *
+ * @param st - pointer on the __qstat
+ * @param name - name of the queue
+ */
+void qstat_dump(__qstat * const st, const char * const name);
+
+
+
+#endif /* __UTILS_QSTAT_H */
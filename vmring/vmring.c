@@ -0,0 +1,243 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ */
+
+
+#define _GNU_SOURCE
+
+#include "vmring.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <shared_utils.h>
+
+
+/**
+ * Private macros
+ *
+ */
+#define VMRING_SIZE          (ring->mem.size)
+#define VMRING_START         (ring->mem.base)
+#define VMRING_WRAP(pos)     ((pos) >= VMRING_SIZE ? (pos) - VMRING_SIZE : (pos))
+
+
+
+/**
+ *
+ */
+bool vmring_map(__vmring_mem * const mem, const uint32_t size)
+{
+    const uint32_t page = (uint32_t)sysconf(_SC_PAGESIZE);
+    uint8_t * base;
+    int fd;
+
+    /* the round up to the page and "pos + len" of the cursors should not overflow */
+    if (!size || size > UINT32_MAX / 2 - (page - 1)) {
+        return false;
+    }
+
+    mem->size = ((size + page - 1) / page) * page;
+
+    fd = memfd_create("vmring", MFD_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    if (ftruncate(fd, mem->size)) {
+        close(fd);
+        return false;
+    }
+
+    /* reserve address space for two copies */
+    base = mmap(NULL, 2 * (size_t)mem->size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    if (mmap(base, mem->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+            || mmap(base + mem->size, mem->size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, 2 * (size_t)mem->size);
+        close(fd);
+        return false;
+    }
+
+    mem->base = base;
+    mem->fd = fd;
+
+    return true;
+}
+
+
+/**
+ *
+ */
+void vmring_unmap(__vmring_mem * const mem)
+{
+    if (mem->base) {
+        munmap(mem->base, 2 * (size_t)mem->size);
+        close(mem->fd);
+
+        mem->base = NULL;
+        mem->size = 0;
+    }
+}
+
+
+/**
+ *
+ */
+bool vmring_create(__vmring * const ring, const uint32_t size)
+{
+    if (!vmring_map(&ring->mem, size)) {
+        return false;
+    }
+
+    vmring_flush(ring);
+
+    return true;
+}
+
+
+/**
+ *
+ */
+void vmring_destroy(__vmring * const ring)
+{
+    vmring_unmap(&ring->mem);
+}
+
+
+/**
+ *
+ */
+void vmring_flush(__vmring * const ring)
+{
+    ring->in_pos = ring->out_pos = 0;
+    ring->data_len = 0;
+}
+
+
+/**
+ *
+ */
+uint32_t vmring_available_space(__vmring * const ring)
+{
+    return VMRING_SIZE - ring->data_len;
+}
+
+
+/**
+ *
+ */
+uint32_t vmring_filled_space(__vmring * const ring)
+{
+    return ring->data_len;
+}
+
+
+/**
+ *
+ */
+bool vmring_push_byte(__vmring * const ring, const uint8_t byte)
+{
+    return vmring_push_data(ring, &byte, 1);
+}
+
+
+/**
+ *
+ */
+uint8_t vmring_pop_byte(__vmring * const ring)
+{
+    uint8_t byte;
+
+    byte = 0;
+    vmring_pop_data(ring, &byte, 1);
+
+    return byte;
+}
+
+
+/**
+ *
+ */
+bool vmring_push_data(__vmring * const ring, const uint8_t * const src, const uint32_t len)
+{
+    if (len > VMRING_SIZE - ring->data_len) {
+        return false;
+    }
+
+    /* the span after in_pos is contiguous in the mirror */
+    mem_copy(VMRING_START + ring->in_pos, src, len);
+
+    return vmring_commit(ring, len);
+}
+
+
+/**
+ *
+ */
+bool vmring_pop_data(__vmring * const ring, uint8_t * const dst, const uint32_t len)
+{
+    if (len > ring->data_len) {
+        return false;
+    }
+
+    mem_copy(dst, VMRING_START + ring->out_pos, len);
+
+    return vmring_shift_cursor(ring, len);
+}
+
+
+/**
+ *
+ */
+void vmring_get_cursor(__vmring * const ring, const uint8_t ** cursor, uint32_t * len)
+{
+    *cursor = ring->data_len ? VMRING_START + ring->out_pos : NULL;
+    *len = ring->data_len;
+}
+
+
+/**
+ *
+ */
+bool vmring_shift_cursor(__vmring * const ring, const uint32_t len)
+{
+    if (len > ring->data_len) {
+        return false;
+    }
+
+    ring->out_pos = VMRING_WRAP(ring->out_pos + len);
+    ring->data_len -= len;
+
+    return true;
+}
+
+
+/**
+ *
+ */
+void vmring_get_write_cursor(__vmring * const ring, uint8_t ** cursor, uint32_t * len)
+{
+    *len = VMRING_SIZE - ring->data_len;
+    *cursor = *len ? VMRING_START + ring->in_pos : NULL;
+}
+
+
+/**
+ *
+ */
+bool vmring_commit(__vmring * const ring, const uint32_t len)
+{
+    if (len > VMRING_SIZE - ring->data_len) {
+        return false;
+    }
+
+    ring->in_pos = VMRING_WRAP(ring->in_pos + len);
+    ring->data_len += len;
+
+    return true;
+}
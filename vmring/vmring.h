@@ -0,0 +1,165 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ *
+ * Double-mapped ("magic") ring buffer backend for the Linux host builds.
+ *
+ * The same memory (memfd) is mapped twice back-to-back, so the byte at
+ * "base + size + i" is the byte at "base + i". Any readable or writable span
+ * of a ring buffer is always contiguous and a consumer never handles the split
+ * at the wrap point.
+ *
+ * How to use:
+ *
+ * 1) As a backend of the existing buffers. Map the memory by "vmring_map" and
+ *    pass "mem.base" as the data buffer:
+ *      - "__ringbuf": init_ringbuf_spsc(&r, mem.base, mem.size); ringbuf_set_mirrored(&r);
+ *      - "__smem_fifo_handle": {.fifo_buf = mem.base, .fifo_size = mem.size, .mirrored = true}
+ *    Their push/pop API works unchanged, cursors/regions are not split.
+ *    Sizes are limited by uint16_t of those buffers.
+ *
+ * 2) As "__vmring" fifo with 32-bit sizes and the same push/pop/cursor API.
+ *
+ * The size is rounded up to the page size.
+ */
+
+#ifndef __VMRING_H
+#define __VMRING_H
+
+
+#include <stdint.h>
+#include <stdbool.h>
+
+
+/**
+ * @brief Public API macros.
+ *
+ */
+#define VMRING_FLUSH(vr)                        vmring_flush((vr))
+#define VMRING_AVAILABLE_SPACE(vr)              vmring_available_space((vr))
+#define VMRING_FILLED_SPACE(vr)                 vmring_filled_space((vr))
+#define VMRING_POP_DATA(vr,buf,len)             vmring_pop_data((vr),(buf),(len))
+#define VMRING_POP_BYTE(vr)                     vmring_pop_byte((vr))
+#define VMRING_PUSH_DATA(vr,buf,len)            vmring_push_data((vr),(buf),(len))
+#define VMRING_PUSH_BYTE(vr,byte)               vmring_push_byte((vr),(byte))
+
+#define VMRING_GET_CURSOR(vr,buf,plen)          vmring_get_cursor((vr),(buf),(plen))
+#define VMRING_SHIFT_CURSOR(vr,len)             vmring_shift_cursor((vr),(len))
+#define VMRING_GET_WRITE_CURSOR(vr,buf,plen)    vmring_get_write_cursor((vr),(buf),(plen))
+#define VMRING_COMMIT(vr,len)                   vmring_commit((vr),(len))
+
+
+
+/**
+ * @brief Double-mapped memory
+ *
+ * @field base - start of the mapping, 2 * size bytes of address space
+ * @field size - size of memory, multiple of the page size
+ * @field fd - memfd
+ */
+typedef struct __vmring_mem {
+    uint8_t * base;
+    uint32_t size;
+    int fd;
+} __vmring_mem;
+
+
+/**
+ * @brief Fifo on the double-mapped memory
+ */
+typedef struct __vmring {
+    __vmring_mem mem;
+
+    uint32_t in_pos;
+    uint32_t out_pos;
+    uint32_t data_len;
+} __vmring;
+
+
+
+/**
+ * @brief Map the memory twice back-to-back.
+ *
+ * @param mem - pointer on "__vmring_mem"
+ * @param size - size of memory, rounded up to the page size
+ * @return false if size is 0 or more than 2 GiB after the round up, or the system call is failed
+ */
+bool vmring_map(__vmring_mem * const mem, const uint32_t size);
+
+/**
+ * @brief Unmap the memory.
+ */
+void vmring_unmap(__vmring_mem * const mem);
+
+/**
+ * @brief Map the memory and flush fifo.
+ */
+bool vmring_create(__vmring * const ring, const uint32_t size);
+
+/**
+ * @brief Unmap the memory of fifo.
+ */
+void vmring_destroy(__vmring * const ring);
+
+/**
+ *
+ */
+void vmring_flush(__vmring * const ring);
+
+/**
+ *
+ */
+uint32_t vmring_available_space(__vmring * const ring);
+
+/**
+ *
+ */
+uint32_t vmring_filled_space(__vmring * const ring);
+
+/**
+ *
+ */
+bool vmring_push_byte(__vmring * const ring, const uint8_t byte);
+
+/**
+ *
+ */
+bool vmring_push_data(__vmring * const ring, const uint8_t * const src, const uint32_t len);
+
+/**
+ *
+ */
+uint8_t vmring_pop_byte(__vmring * const ring);
+
+/**
+ *
+ */
+bool vmring_pop_data(__vmring * const ring, uint8_t * const dst, const uint32_t len);
+
+/**
+ * @brief Get all data as one contiguous segment.
+ */
+void vmring_get_cursor(__vmring * const ring, const uint8_t ** cursor, uint32_t * len);
+
+/**
+ *
+ */
+bool vmring_shift_cursor(__vmring * const ring, const uint32_t len);
+
+/**
+ * @brief Get all free space as one contiguous segment (e.g. for read() or DMA).
+ */
+void vmring_get_write_cursor(__vmring * const ring, uint8_t ** cursor, uint32_t * len);
+
+/**
+ * @brief Publish len bytes written through the write cursor.
+ */
+bool vmring_commit(__vmring * const ring, const uint32_t len);
+
+/**
+ * @brief Tests
+ */
+void vmring_run_tests(void);
+
+
+
+#endif /* __VMRING_H */
@@ -0,0 +1,236 @@
+/**
+ * Author: Serge Maslyakov, rusoil.9@gmail.com
+ */
+
+
+
+#include "vmring.h"
+
+#include <v_printf.h>
+#include <shared_utils.h>
+#include <smfifo.h>
+#include <ringbuf.h>
+
+#include <unistd.h>
+
+
+static void assert(bool value, const char *error) {
+    if (!value) {
+        v_printf("Assert error:%s\r\n", error);
+
+        while(1);
+    }
+}
+
+
+#define PRINT_TEST_NAME(s)        v_printf(#s, 1)
+#define VMRING_TEST_SIZE          ((uint32_t)sysconf(_SC_PAGESIZE))
+#define VMRING_TEST_BIG_SIZE      0x100000
+
+
+
+static void vmring_map_test(void);
+static void vmring_fifo_test(void);
+static void vmring_big_fifo_test(void);
+static void vmring_smfifo_test(void);
+static void vmring_ringbuf_test(void);
+
+
+
+/**
+ *
+ */
+void vmring_run_tests(void)
+{
+    /*******/
+    vmring_map_test();
+
+    /*******/
+    vmring_fifo_test();
+
+    /*******/
+    vmring_big_fifo_test();
+
+    /*******/
+    vmring_smfifo_test();
+
+    /*******/
+    vmring_ringbuf_test();
+
+    v_printf("Vmring tests have finished successfully\r\n", 1);
+}
+
+
+/**
+ *
+ */
+static void vmring_map_test(void)
+{
+    __vmring_mem mem;
+
+    PRINT_TEST_NAME(vmring_map_test\r\n);
+
+    assert(vmring_map(&mem, 100), "Map should be OK");
+    assert(mem.size == VMRING_TEST_SIZE, "Size should be rounded up to the page");
+
+    mem.base[10] = 0x5a;
+    assert(mem.base[mem.size + 10] == 0x5a, "Mirror should see the write");
+
+    mem.base[mem.size + 20] = 0xa5;
+    assert(mem.base[20] == 0xa5, "Memory should see the write into mirror");
+
+    vmring_unmap(&mem);
+
+    assert(!vmring_map(&mem, 0xFFFFFFFF), "Round up should not overflow");
+    assert(!vmring_map(&mem, 0x80000001), "Cursors should not overflow");
+    assert(mem.base == NULL, "Should be unmapped");
+}
+
+
+/**
+ *
+ */
+static void vmring_fifo_test(void)
+{
+    uint8_t buf[16];
+    const uint8_t * cursor;
+    uint8_t * wcursor;
+    uint32_t len;
+    __vmring vr;
+
+    PRINT_TEST_NAME(vmring_fifo_test\r\n);
+
+    assert(vmring_create(&vr, VMRING_TEST_SIZE), "Create should be OK");
+    assert(VMRING_AVAILABLE_SPACE(&vr) == VMRING_TEST_SIZE, "Should be empty");
+
+    /* move cursors close to the end */
+    VMRING_GET_WRITE_CURSOR(&vr, &wcursor, &len);
+    assert(len == VMRING_TEST_SIZE, "All space should be free");
+    VMRING_COMMIT(&vr, VMRING_TEST_SIZE - 4);
+    VMRING_SHIFT_CURSOR(&vr, VMRING_TEST_SIZE - 4);
+
+    assert(VMRING_PUSH_DATA(&vr, (const uint8_t *)"test1234", 8), "Push should be OK");
+    assert(VMRING_FILLED_SPACE(&vr) == 8, "Should be 8");
+
+    /* the data runs over the wrap point, but the cursor is contiguous */
+    VMRING_GET_CURSOR(&vr, &cursor, &len);
+    assert(len == 8 && mem_cmp(cursor, "test1234", 8), "Cursor should not be split");
+
+    assert(VMRING_POP_BYTE(&vr) == 't', "Should be t");
+    assert(VMRING_POP_DATA(&vr, buf, 7) && mem_cmp(buf, "est1234", 7), "Pop data is worked wrong");
+    assert(!VMRING_POP_DATA(&vr, buf, 1), "Should be empty");
+
+    assert(!VMRING_PUSH_DATA(&vr, buf, VMRING_TEST_SIZE + 1), "Should not fit");
+
+    vmring_destroy(&vr);
+}
+
+
+/**
+ *
+ */
+static void vmring_big_fifo_test(void)
+{
+    const uint8_t * cursor;
+    uint8_t * wcursor;
+    uint32_t len;
+    uint32_t i;
+    __vmring vr;
+
+    PRINT_TEST_NAME(vmring_big_fifo_test\r\n);
+
+    assert(vmring_create(&vr, VMRING_TEST_BIG_SIZE), "Create should be OK");
+
+    VMRING_COMMIT(&vr, VMRING_TEST_BIG_SIZE / 2);
+    VMRING_SHIFT_CURSOR(&vr, VMRING_TEST_BIG_SIZE / 2);
+
+    VMRING_GET_WRITE_CURSOR(&vr, &wcursor, &len);
+    assert(len == VMRING_TEST_BIG_SIZE, "All space should be free");
+
+    for (i = 0; i < len; i++) {
+        wcursor[i] = (uint8_t)i;
+    }
+
+    VMRING_COMMIT(&vr, len);
+
+    VMRING_GET_CURSOR(&vr, &cursor, &len);
+    assert(len == VMRING_TEST_BIG_SIZE, "Should be full");
+
+    for (i = 0; i < len; i++) {
+        assert(cursor[i] == (uint8_t)i, "Wrong data");
+    }
+
+    vmring_destroy(&vr);
+}
+
+
+/**
+ *
+ */
+static void vmring_smfifo_test(void)
+{
+    __vmring_mem mem;
+    const uint8_t * cursor;
+    uint16_t len;
+
+    PRINT_TEST_NAME(vmring_smfifo_test\r\n);
+
+    /* the mirrored fifo is a page at least, the size of smfifo is 16 bits */
+    if (VMRING_TEST_SIZE > 0xFFFF) {
+        return;
+    }
+
+    assert(vmring_map(&mem, VMRING_TEST_SIZE), "Map should be OK");
+
+    __smem_fifo_handle fifo = {
+        .fifo_buf = mem.base,
+        .fifo_size = VMRING_TEST_SIZE,
+        .mirrored = true
+    };
+
+    SMEM_FIFO_FLUSH(&fifo);
+
+    SMEM_FIFO_PUSH_DATA(&fifo, mem.base, VMRING_TEST_SIZE - 2);
+    SMEM_FIFO_SHIFT_CURSOR(&fifo, VMRING_TEST_SIZE - 2);
+
+    SMEM_FIFO_PUSH_DATA(&fifo, (const uint8_t *)"frame", 5);
+
+    SMEM_FIFO_GET_CURSOR(&fifo, &cursor, &len);
+    assert(len == 5 && mem_cmp(cursor, "frame", 5), "Cursor should not be split");
+
+    vmring_unmap(&mem);
+}
+
+
+/**
+ *
+ */
+static void vmring_ringbuf_test(void)
+{
+    __vmring_mem mem;
+    __ringbuf rb;
+    const uint8_t * region;
+    uint16_t len;
+
+    PRINT_TEST_NAME(vmring_ringbuf_test\r\n);
+
+    /* the mirrored ring is a page at least, the SPSC ring is 32768 bytes at most */
+    if (VMRING_TEST_SIZE > 0x8000) {
+        return;
+    }
+
+    assert(vmring_map(&mem, VMRING_TEST_SIZE), "Map should be OK");
+
+    assert(init_ringbuf_spsc(&rb, mem.base, mem.size), "Init should be OK");
+    ringbuf_set_mirrored(&rb);
+
+    ringbuf_write_commit(&rb, VMRING_TEST_SIZE - 2);
+    ringbuf_read_release(&rb, VMRING_TEST_SIZE - 2);
+
+    put_block_ringbuf(rb, (const uint8_t *)"frame", 5);
+
+    len = read_peek_ringbuf(rb, &region);
+    assert(len == 5 && mem_cmp(region, "frame", 5), "Region should not be split");
+
+    vmring_unmap(&mem);
+}